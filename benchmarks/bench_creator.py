@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Creator items per second, Python items versus native StaticItem """
+
+import itertools
+
+import pytest
+
+import libzim.writer
+from libzim.writer import Creator, StringProvider
+
+WORKERS = [1, 2, 4]
+
+
+class PyItem(libzim.writer.Item):
+    def __init__(self, path, title, content):
+        super().__init__()
+        self.path = path
+        self.title = title
+        self.content = content
+
+    def get_path(self):
+        return self.path
+
+    def get_title(self):
+        return self.title
+
+    def get_mimetype(self):
+        return "text/html"
+
+    def get_contentprovider(self):
+        return StringProvider(self.content)
+
+
+ITEM_TYPES = {
+    "python": PyItem,
+    "native": lambda path, title, content: libzim.writer.StaticItem(
+        path, title, "text/html", content
+    ),
+}
+
+
+@pytest.mark.benchmark(group="creator")
+@pytest.mark.parametrize("nb_workers", WORKERS)
+@pytest.mark.parametrize("item_type", list(ITEM_TYPES))
+def bench_creator(
+    benchmark,
+    tmp_path,
+    bench_paths,
+    bench_titles,
+    bench_contents,
+    item_type,
+    nb_workers,
+):
+    make_item = ITEM_TYPES[item_type]
+    counter = itertools.count()
+
+    def setup():
+        return (tmp_path / f"round{next(counter)}.zim",), {}
+
+    def create(fpath):
+        with Creator(fpath).config_nbworkers(nb_workers) as creator:
+            creator.add_items(
+                make_item(path, title, content)
+                for path, title, content in zip(
+                    bench_paths, bench_titles, bench_contents
+                )
+            )
+        fpath.unlink()
+
+    benchmark.extra_info["items_per_round"] = len(bench_paths)
+    benchmark.pedantic(create, setup=setup, rounds=3)
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Per-item overhead of the Creator
+
+    Adds `--zim-entries` tiny items so that the cost of wrapping/constructing
+    items (and calling back into Python) dominates over compression and I/O. """
+
+import itertools
+
+import pytest
+
+import libzim.writer
+from libzim.writer import Creator, StringProvider
+
+CONTENT = b"content"
+
+
+class PyItem(libzim.writer.Item):
+    def __init__(self, path, content):
+        super().__init__()
+        self.path = path
+        self.content = content
+
+    def get_path(self):
+        return self.path
+
+    def get_title(self):
+        return ""
+
+    def get_mimetype(self):
+        return "text/plain"
+
+    def get_contentprovider(self):
+        return StringProvider(self.content)
+
+
+def python_items(creator, paths):
+    for path in paths:
+        creator.add_item(PyItem(path, CONTENT))
+
+
+def python_items_bulk(creator, paths):
+    creator.add_items(PyItem(path, CONTENT) for path in paths)
+
+
+def static_items(creator, paths):
+    for path in paths:
+        creator.add_item(libzim.writer.StaticItem(path, "", "text/plain", CONTENT))
+
+
+ADDERS = {
+    "python": python_items,
+    "python_bulk": python_items_bulk,
+    "native": static_items,
+}
+
+
+@pytest.mark.benchmark(group="creator-items")
+@pytest.mark.parametrize("adder", list(ADDERS))
+def bench_creator_items(benchmark, tmp_path, bench_paths, adder):
+    add = ADDERS[adder]
+    counter = itertools.count()
+
+    def setup():
+        return (tmp_path / f"round{next(counter)}.zim",), {}
+
+    def create(fpath):
+        with Creator(fpath).config_nbworkers(4) as creator:
+            add(creator, bench_paths)
+        fpath.unlink()
+
+    benchmark.extra_info["items_per_round"] = len(bench_paths)
+    benchmark.pedantic(create, setup=setup, rounds=3)
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Archive lookups and content reads """
+
+import random
+
+import pytest
+
+from libzim.reader import Archive
+
+
+@pytest.fixture(scope="module")
+def archive(bench_zim):
+    return Archive(bench_zim)
+
+
+def lookup_all(lookup, keys):
+    for key in keys:
+        lookup(key)
+
+
+@pytest.mark.benchmark(group="lookups")
+def bench_lookup_by_path(benchmark, archive, bench_paths):
+    benchmark.extra_info["lookups_per_round"] = len(bench_paths)
+    benchmark(lookup_all, archive.get_entry_by_path, bench_paths)
+
+
+@pytest.mark.benchmark(group="lookups")
+def bench_lookup_by_title(benchmark, archive, bench_titles):
+    benchmark.extra_info["lookups_per_round"] = len(bench_titles)
+    benchmark(lookup_all, archive.get_entry_by_title, bench_titles)
+
+
+@pytest.mark.benchmark(group="lookups")
+def bench_lookup_batch(benchmark, archive, bench_paths):
+    benchmark.extra_info["lookups_per_round"] = len(bench_paths)
+    benchmark(archive.get_entries_by_path, bench_paths)
+
+
+def read_all(items):
+    size = 0
+    for item in items:
+        size += item.read().nbytes
+    return size
+
+
+@pytest.mark.benchmark(group="content")
+@pytest.mark.parametrize("order", ["sequential", "random"])
+@pytest.mark.parametrize("compression", ["zstd", "none"])
+def bench_content(benchmark, bench_zims, bench_paths, compression, order):
+    # own archive with a tiny cluster cache: decompression is part of the cost
+    archive = Archive(bench_zims[compression], shared=False, cluster_cache_size=1)
+    paths = list(bench_paths)
+    if order == "random":
+        random.Random(0).shuffle(paths)
+    items = [archive.get_entry_by_path(path).get_item() for path in paths]
+    benchmark.extra_info["bytes_per_round"] = sum(item.size for item in items)
+    benchmark(read_all, items)
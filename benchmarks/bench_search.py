@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Full-text search and title suggestion latency """
+
+import pytest
+
+from libzim.reader import Archive
+from libzim.search import Query, Searcher
+
+QUERIES = ["lorem", "dolor magna", "exercitation ullamco laboris"]
+
+
+@pytest.fixture(scope="module")
+def archive(bench_zim):
+    return Archive(bench_zim)
+
+
+def first_results(searcher, method, query):
+    search = getattr(searcher, method)(Query().set_query(query))
+    return search.get_estimated_matches(), list(search.get_results(0, 10))
+
+
+@pytest.mark.benchmark(group="search")
+@pytest.mark.parametrize("query", QUERIES)
+@pytest.mark.parametrize("method", ["search", "suggest"])
+def bench_search(benchmark, archive, method, query):
+    # no cache of searches: each round runs the query in libzim
+    searcher = Searcher(archive, cache_size=0)
+    benchmark(first_results, searcher, method, query)
+
+
+@pytest.mark.benchmark(group="search-cached")
+@pytest.mark.parametrize("method", ["search", "suggest"])
+def bench_search_cached(benchmark, archive, method):
+    searcher = Searcher(archive)
+    benchmark(first_results, searcher, method, QUERIES[0])
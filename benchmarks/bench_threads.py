@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Multi-threaded read scaling on a single Archive
+
+    Each round reads the content of all fixture items, split over the
+    threads. As reads release the GIL, rounds should get faster with more
+    threads (up to the number of cores). """
+
+import threading
+
+import pytest
+
+from libzim.reader import Archive
+
+THREADS = [1, 2, 4, 8]
+
+
+def read_split(archive, paths, nb_threads):
+    def reader(offset):
+        for path in paths[offset::nb_threads]:
+            archive.get_entry_by_path(path).get_item().content
+
+    threads = [
+        threading.Thread(target=reader, args=(offset,)) for offset in range(nb_threads)
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+
+@pytest.mark.benchmark(group="threads")
+@pytest.mark.parametrize("nb_threads", THREADS)
+@pytest.mark.parametrize("compression", ["zstd", "none"])
+def bench_read_threads(benchmark, bench_zims, bench_paths, compression, nb_threads):
+    archive = Archive(bench_zims[compression])
+    benchmark.extra_info["items_per_round"] = len(bench_paths)
+    benchmark.pedantic(
+        read_split, args=(archive, bench_paths, nb_threads), rounds=5, warmup_rounds=1
+    )
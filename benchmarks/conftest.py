@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Fixture ZIMs for the benchmark suite
+
+    ZIMs are generated once per session, in a temporary directory, with
+    `--zim-entries` HTML items of about `--zim-content-size` bytes each
+    (deterministic content), indexed for full-text search.
+
+    Usage (from this directory):
+
+    pytest --zim-entries 20000 --benchmark-autosave """
+
+import pathlib
+import random
+
+import pytest
+
+import libzim.writer
+from libzim.writer import Compression, Creator
+
+WORDS = (
+    "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua enim ad minim veniam quis nostrud "
+    "exercitation ullamco laboris nisi aliquip ex ea commodo consequat duis aute"
+).split()
+
+
+def pytest_addoption(parser):
+    group = parser.getgroup("libzim", "libzim benchmarks")
+    group.addoption(
+        "--zim-entries", type=int, default=2000, help="items in fixture ZIMs"
+    )
+    group.addoption(
+        "--zim-content-size",
+        type=int,
+        default=4096,
+        help="approximate content size of fixture items (bytes)",
+    )
+
+
+def make_content(rand, index, size):
+    words = []
+    length = 0
+    while length < size:
+        word = rand.choice(WORDS)
+        words.append(word)
+        length += len(word) + 1
+    return (
+        f"<html><head><title>Article {index}</title></head>"
+        f"<body><p>{' '.join(words)}</p></body></html>"
+    )
+
+
+@pytest.fixture(scope="session")
+def zim_entries(request):
+    # options are only registered when running from this directory
+    return request.config.getoption("--zim-entries", default=2000)
+
+
+@pytest.fixture(scope="session")
+def zim_content_size(request):
+    return request.config.getoption("--zim-content-size", default=4096)
+
+
+@pytest.fixture(scope="session")
+def bench_contents(zim_entries, zim_content_size):
+    """HTML content of each fixture entry, always the same for given options"""
+    rand = random.Random(zim_entries)
+    return [
+        make_content(rand, index, zim_content_size) for index in range(zim_entries)
+    ]
+
+
+@pytest.fixture(scope="session")
+def bench_zims(tmp_path_factory, bench_paths, bench_titles, bench_contents):
+    """pathlib.Path of the fixture ZIM for each compression name"""
+    folder = pathlib.Path(tmp_path_factory.mktemp("bench-zims"))
+    zims = {}
+    for compression in (Compression.zstd, Compression.none):
+        fpath = folder / f"bench-{compression.name}.zim"
+        with Creator(fpath).config_compression(compression).config_indexing(
+            True, "eng"
+        ) as creator:
+            creator.add_items(
+                libzim.writer.StaticItem(path, title, "text/html", content)
+                for path, title, content in zip(
+                    bench_paths, bench_titles, bench_contents
+                )
+            )
+            creator.add_metadata("Title", b"Benchmark")
+            creator.set_mainpath("A/article0")
+        zims[compression.name] = fpath
+    return zims
+
+
+@pytest.fixture(scope="session")
+def bench_zim(bench_zims):
+    """Default (zstd compressed) fixture ZIM"""
+    return bench_zims["zstd"]
+
+
+@pytest.fixture(scope="session")
+def bench_paths(zim_entries):
+    return [f"A/article{index}" for index in range(zim_entries)]
+
+
+@pytest.fixture(scope="session")
+def bench_titles(zim_entries):
+    return [f"Article {index}" for index in range(zim_entries)]
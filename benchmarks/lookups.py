@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Entry/Item lookups per second on a single thread
+
+    Usage:
+
+    python3 benchmarks/lookups.py wikipedia.zim --rounds 5 """
+
+import argparse
+import time
+
+from libzim.reader import Archive
+
+
+def by_path(archive, paths):
+    for path in paths:
+        archive.get_entry_by_path(path)
+
+
+def by_path_with_item(archive, paths):
+    for path in paths:
+        archive.get_entry_by_path(path).get_item()
+
+
+def by_id(archive, paths):
+    for index in range(len(paths)):
+        archive._get_entry_by_id(index)
+
+
+def batch(archive, paths):
+    archive.get_entries_by_path(paths)
+
+
+BENCHMARKS = [by_path, by_path_with_item, by_id, batch]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("zim", help="ZIM file to read from")
+    parser.add_argument("--rounds", type=int, default=5)
+    parser.add_argument("--limit", type=int, default=100000, help="max paths to use")
+    args = parser.parse_args()
+
+    archive = Archive(args.zim)
+    nb_entries = min(archive.entry_count, args.limit)
+    paths = [archive._get_entry_by_id(index).path for index in range(nb_entries)]
+    if not paths:
+        parser.error(f"{args.zim} has no entry")
+
+    for bench in BENCHMARKS:
+        best = None
+        for _ in range(args.rounds):
+            start = time.perf_counter()
+            bench(archive, paths)
+            duration = time.perf_counter() - start
+            best = duration if best is None else min(best, duration)
+        print(f"{bench.__name__:>20}: {len(paths) / best:>12.0f} lookups/s")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+
+# This file is part of python-libzim
+# (see https://github.com/libzim/python-libzim)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+""" Threaded read throughput on a single Archive
+
+    Every thread fetches entries by path and reads their whole content.
+    As reader calls release the GIL, throughput should grow with the number
+    of threads until I/O or CPU is saturated.
+
+    Usage:
+
+    python3 benchmarks/reader_threads.py wikipedia.zim --threads 1 2 4 8 """
+
+import argparse
+import itertools
+import threading
+import time
+
+from libzim.reader import Archive
+
+
+def get_paths(archive, limit):
+    paths = []
+    for index in range(0, archive.entry_count):
+        entry = archive._get_entry_by_id(index)
+        if not entry.is_redirect:
+            paths.append(entry.path)
+        if limit and len(paths) >= limit:
+            break
+    return paths
+
+
+def run(archive, paths, nb_threads, duration):
+    """number of items read in `duration` seconds using `nb_threads` threads"""
+    counts = [0] * nb_threads
+    stop = threading.Event()
+
+    def reader(thread_index):
+        # each thread starts at a different offset to avoid reading
+        # exactly the same clusters at the same time
+        offset = thread_index * len(paths) // nb_threads
+        for path in itertools.cycle(paths[offset:] + paths[:offset]):
+            if stop.is_set():
+                break
+            _ = archive.get_entry_by_path(path).get_item().content
+            counts[thread_index] += 1
+
+    threads = [
+        threading.Thread(target=reader, args=(index,)) for index in range(nb_threads)
+    ]
+    for thread in threads:
+        thread.start()
+    time.sleep(duration)
+    stop.set()
+    for thread in threads:
+        thread.join()
+    return sum(counts)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("zim", help="ZIM file to read from")
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 2, 4, 8])
+    parser.add_argument("--duration", type=float, default=5.0, help="seconds per run")
+    parser.add_argument("--limit", type=int, default=10000, help="max paths to use")
+    args = parser.parse_args()
+
+    archive = Archive(args.zim)
+    paths = get_paths(archive, args.limit)
+    if not paths:
+        parser.error(f"{args.zim} has no item to read")
+
+    base = None
+    for nb_threads in args.threads:
+        nb_items = run(archive, paths, nb_threads, args.duration)
+        rate = nb_items / args.duration
+        base = base or rate
+        print(f"{nb_threads:>3} thread(s): {rate:>10.0f} items/s  x{rate / base:.2f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -25,52 +25,213 @@
 
 #include "wrapper_api.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
 #include <cstdlib>
+#include <cstring>
+#include <ios>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <system_error>
 #include <zim/blob.h>
+#include <zim/error.h>
 #include <zim/writer/creator.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
-ObjWrapper::ObjWrapper(PyObject* obj)
-  : m_obj(obj)
+
+namespace
+{
+
+// Set once the C API of the wrapper module (wrapper_api.h) is resolved.
+// Wrappers are always constructed with the GIL held, which serializes
+// access to it. (A std::call_once could deadlock if the import released
+// the GIL while another thread is waiting on the flag.)
+bool wrapperApiImported = false;
+
+void importWrapperApi()
 {
- if (import_libzim__wrapper()) {
+  if (wrapperApiImported)
+    return;
+  if (import_libzim__wrapper()) {
     std::cerr << "Error executing import_libzim!\n";
     throw std::runtime_error("Error executing import_libzim");
-  } else {
-    Py_XINCREF(this->m_obj);
+  }
+  wrapperApiImported = true;
+}
+
+} // namespace
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t nanoseconds(Clock::duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Holds the GIL during a call into Python, accounting time waiting for
+// it and time spent in the call to stats (if any).
+// (Cython `with gil` functions then don't wait for the GIL)
+class PythonCall
+{
+  public:
+    explicit PythonCall(CreatorStats* stats)
+      : m_stats(stats)
+    {
+      if (!m_stats)
+        return;
+      const auto start = Clock::now();
+      m_gstate = PyGILState_Ensure();
+      m_start = Clock::now();
+      m_stats->gilWaitNs += nanoseconds(m_start - start);
+    }
+
+    ~PythonCall()
+    {
+      if (!m_stats)
+        return;
+      m_stats->callbackNs += nanoseconds(Clock::now() - m_start);
+      ++m_stats->callbackCalls;
+      PyGILState_Release(m_gstate);
+    }
+
+  private:
+    CreatorStats* m_stats;
+    PyGILState_STATE m_gstate;
+    Clock::time_point m_start;
+};
+
+} // namespace
+
+CreatorStatsSnapshot CreatorStats::snapshot() const
+{
+  return CreatorStatsSnapshot{
+    itemsAdded, addItemNs, callbackCalls, callbackNs, gilWaitNs, bytesIn};
+}
+
+void addItem(zim::writer::Creator& creator,
+             const std::shared_ptr<zim::writer::Item>& item,
+             CreatorStats& stats,
+             CreatorDedup* dedup)
+{
+  const auto start = Clock::now();
+  if (dedup)
+    dedup->addItem(creator, item, stats);
+  else
+    creator.addItem(item);
+  stats.addItemNs += nanoseconds(Clock::now() - start);
+  ++stats.itemsAdded;
+}
+
+ObjWrapper::ObjWrapper(PyObject* obj, std::shared_ptr<CreatorStats> stats)
+  : m_obj(obj),
+    m_methods(),
+    m_stats(stats)
+{
+  importWrapperApi();
+  Py_XINCREF(this->m_obj);
+}
+
+namespace
+{
+
+// References of a destroyed wrapper, waiting for the GIL to be released
+struct DeferredReferences
+{
+  PyObject* objects[PY_METHOD_COUNT + 1];
+  DeferredReferences* next;
+};
+
+// Treiber stack. Consumers take the whole stack at once (exchange) so there
+// is no ABA issue on pop.
+std::atomic<DeferredReferences*> deferredReferences(nullptr);
+
+int releaseDeferredReferencesCall(void*)
+{
+  releaseDeferredReferences();
+  return 0;
+}
+
+void deferReferences(DeferredReferences* refs)
+{
+  refs->next = deferredReferences.load(std::memory_order_relaxed);
+  while (!deferredReferences.compare_exchange_weak(
+      refs->next, refs, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+  // first one since last release: have the interpreter release them (with
+  // the GIL) soon, even if no other call releases them. Needs no GIL ; if
+  // pending calls are full, next releaseDeferredReferences() does it.
+  if (!refs->next)
+    Py_AddPendingCall(releaseDeferredReferencesCall, nullptr);
+}
+
+} // namespace
+
+void releaseDeferredReferences()
+{
+  DeferredReferences* refs = deferredReferences.exchange(nullptr, std::memory_order_acquire);
+  while (refs) {
+    for (auto obj : refs->objects) {
+      Py_XDECREF(obj);
+    }
+    DeferredReferences* next = refs->next;
+    delete refs;
+    refs = next;
   }
 }
 
 ObjWrapper::~ObjWrapper()
 {
-  PyGILState_STATE gstate;
-  gstate = PyGILState_Ensure();
-  Py_XDECREF(this->m_obj);
-  PyGILState_Release(gstate);
+  if (PyGILState_Check()) {
+    for (auto method : this->m_methods) {
+      Py_XDECREF(method);
+    }
+    Py_XDECREF(this->m_obj);
+    return;
+  }
+
+  // No GIL (libzim worker thread): don't wait for it, queue references
+  auto refs = new DeferredReferences;
+  std::copy(std::begin(this->m_methods), std::end(this->m_methods), refs->objects);
+  refs->objects[PY_METHOD_COUNT] = this->m_obj;
+  deferReferences(refs);
 }
 
-std::string ObjWrapper::callCythonReturnString(std::string methodName) const
+std::string ObjWrapper::callCythonReturnString(PyMethod method) const
 {
   if (!this->m_obj)
     throw std::runtime_error("Python object not set");
 
   std::string error;
 
-  std::string ret_val = string_cy_call_fct(this->m_obj, methodName, &error);
+  PythonCall call(m_stats.get());
+  std::string ret_val = string_cy_call_fct(this->m_obj, this->m_methods, method, &error);
   if (!error.empty())
     throw std::runtime_error(error);
   return ret_val;
 }
 
-uint64_t ObjWrapper::callCythonReturnInt(std::string methodName) const
+uint64_t ObjWrapper::callCythonReturnInt(PyMethod method) const
 {
   if (!this->m_obj)
       throw std::runtime_error("Python object not set");
 
   std::string error;
 
-  int64_t ret_val = int_cy_call_fct(this->m_obj, methodName, &error);
+  PythonCall call(m_stats.get());
+  int64_t ret_val = int_cy_call_fct(this->m_obj, this->m_methods, method, &error);
   if (!error.empty())
     throw std::runtime_error(error);
 
@@ -86,22 +247,23 @@ uint64_t ObjWrapper::callCythonReturnInt(std::string methodName) const
 
 zim::size_type ContentProviderWrapper::getSize() const
 {
-  return callCythonReturnInt("get_size");
+  return callCythonReturnInt(PY_GET_SIZE);
 }
 
 zim::Blob ContentProviderWrapper::feed()
 {
-  return callCythonReturnBlob("feed");
+  return callCythonReturnBlob(PY_FEED);
 }
 
-zim::Blob ContentProviderWrapper::callCythonReturnBlob(std::string methodName) const
+zim::Blob ContentProviderWrapper::callCythonReturnBlob(PyMethod method) const
 {
   if (!this->m_obj)
     throw std::runtime_error("Python object not set");
 
   std::string error;
 
-  zim::Blob ret_val = blob_cy_call_fct(this->m_obj, methodName, &error);
+  PythonCall call(m_stats.get());
+  zim::Blob ret_val = blob_cy_call_fct(this->m_obj, this->m_methods, method, &error);
   if (!error.empty())
     throw std::runtime_error(error);
 
@@ -115,14 +277,15 @@ zim::Blob ContentProviderWrapper::callCythonReturnBlob(std::string methodName) c
 */
 
 
-std::unique_ptr<zim::writer::ContentProvider> WriterItemWrapper::callCythonReturnContentProvider(std::string methodName) const
+std::unique_ptr<zim::writer::ContentProvider> WriterItemWrapper::callCythonReturnContentProvider(PyMethod method) const
 {
   if (!this->m_obj)
     throw std::runtime_error("Python object not set");
 
   std::string error;
 
-  auto ret_val = std::unique_ptr<zim::writer::ContentProvider>(contentprovider_cy_call_fct(this->m_obj, methodName, &error));
+  PythonCall call(m_stats.get());
+  auto ret_val = std::unique_ptr<zim::writer::ContentProvider>(contentprovider_cy_call_fct(this->m_obj, this->m_methods, method, &error));
   if (!error.empty())
     throw std::runtime_error(error);
 
@@ -132,23 +295,1773 @@ std::unique_ptr<zim::writer::ContentProvider> WriterItemWrapper::callCythonRetur
 std::string
 WriterItemWrapper::getPath() const
 {
-  return callCythonReturnString("get_path");
+  return callCythonReturnString(PY_GET_PATH);
 }
 
 std::string
 WriterItemWrapper::getTitle() const
 {
-  return callCythonReturnString("get_title");
+  return callCythonReturnString(PY_GET_TITLE);
 }
 
 std::string
 WriterItemWrapper::getMimeType() const
 {
-  return callCythonReturnString("get_mimetype");
+  return callCythonReturnString(PY_GET_MIMETYPE);
 }
 
 std::unique_ptr<zim::writer::ContentProvider>
 WriterItemWrapper::getContentProvider() const
 {
-    return callCythonReturnContentProvider("get_contentprovider");
+  auto provider = callCythonReturnContentProvider(PY_GET_CONTENTPROVIDER);
+  if (!m_stats)
+    return provider;
+  if (auto wrapper = dynamic_cast<ContentProviderWrapper*>(provider.get()))
+    wrapper->setStats(m_stats);
+  if (m_contentCounted.exchange(true))
+    return provider;
+  return std::unique_ptr<zim::writer::ContentProvider>(
+      new CountingContentProvider(std::move(provider), m_stats));
+}
+
+
+/*
+#########################
+#   Creator Item Queue  #
+#########################
+*/
+
+CreatorItemQueue::CreatorItemQueue(zim::writer::Creator& creator, size_t maxSize, CreatorStats& stats,
+                                   CreatorDedup* dedup)
+  : m_creator(creator),
+    m_stats(stats),
+    m_dedup(dedup),
+    m_maxSize(maxSize ? maxSize : 1),
+    m_busy(false),
+    m_stop(false),
+    m_thread(&CreatorItemQueue::run, this)
+{}
+
+CreatorItemQueue::~CreatorItemQueue()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_pushed.notify_all();
+  m_thread.join();
+}
+
+void CreatorItemQueue::rethrowError()
+{
+  // m_mutex must be held
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void CreatorItemQueue::push(const std::shared_ptr<zim::writer::Item>& item)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_popped.wait(lock, [this] { return m_queue.size() < m_maxSize || m_error; });
+  rethrowError();
+  m_queue.push_back(item);
+  lock.unlock();
+  m_pushed.notify_one();
+}
+
+void CreatorItemQueue::drain()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_popped.wait(lock, [this] { return m_queue.empty() && !m_busy; });
+  rethrowError();
+}
+
+size_t CreatorItemQueue::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_queue.size() + (m_busy ? 1 : 0);
+}
+
+void CreatorItemQueue::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_pushed.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+    if (m_queue.empty())
+      return;  // stopping
+    std::shared_ptr<zim::writer::Item> item = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_busy = true;
+    lock.unlock();
+
+    std::exception_ptr error;
+    try {
+      addItem(m_creator, item, m_stats, m_dedup);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    // release our reference before next (blocking) wait
+    item.reset();
+
+    lock.lock();
+    m_busy = false;
+    if (error && !m_error)
+      m_error = error;
+    m_popped.notify_all();
+  }
+}
+
+/*
+#########################
+#     Creator Dedup     #
+#########################
+*/
+
+namespace {
+
+// XXH64 (https://github.com/Cyan4973/xxHash), not cryptographic but fast ;
+// two seeds make a 128 bits hash for the dedup key
+const uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t XXH_PRIME3 = 0x165667B19E3779F9ULL;
+const uint64_t XXH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t xxhRotl(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t xxhRead64(const unsigned char* data)
+{
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; --i)
+    value = (value << 8) | data[i];
+  return value;
+}
+
+inline uint64_t xxhRead32(const unsigned char* data)
+{
+  return uint64_t(data[0]) | uint64_t(data[1]) << 8
+       | uint64_t(data[2]) << 16 | uint64_t(data[3]) << 24;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+  acc += input * XXH_PRIME2;
+  return xxhRotl(acc, 31) * XXH_PRIME1;
+}
+
+inline uint64_t xxhMerge(uint64_t acc, uint64_t value)
+{
+  acc ^= xxhRound(0, value);
+  return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+uint64_t xxh64(const char* data, size_t size, uint64_t seed)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* const end = p + size;
+  uint64_t hash;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+    uint64_t v2 = seed + XXH_PRIME2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - XXH_PRIME1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = xxhRound(v1, xxhRead64(p));
+      v2 = xxhRound(v2, xxhRead64(p + 8));
+      v3 = xxhRound(v3, xxhRead64(p + 16));
+      v4 = xxhRound(v4, xxhRead64(p + 24));
+    }
+    hash = xxhRotl(v1, 1) + xxhRotl(v2, 7) + xxhRotl(v3, 12) + xxhRotl(v4, 18);
+    hash = xxhMerge(hash, v1);
+    hash = xxhMerge(hash, v2);
+    hash = xxhMerge(hash, v3);
+    hash = xxhMerge(hash, v4);
+  } else {
+    hash = seed + XXH_PRIME5;
+  }
+  hash += size;
+
+  for (; p + 8 <= end; p += 8) {
+    hash ^= xxhRound(0, xxhRead64(p));
+    hash = xxhRotl(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+  }
+  if (p + 4 <= end) {
+    hash ^= xxhRead32(p) * XXH_PRIME1;
+    hash = xxhRotl(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash ^= *p * XXH_PRIME5;
+    hash = xxhRotl(hash, 11) * XXH_PRIME1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+// Item added in place of a deduplicated one: content has already been read
+// (and is given back from memory), anything else is asked to the original.
+class DedupWriterItem : public zim::writer::Item
+{
+  public:
+    DedupWriterItem(const std::shared_ptr<zim::writer::Item>& item,
+                    const std::shared_ptr<const std::string>& content)
+      : m_item(item), m_content(content) {};
+    virtual std::string getPath() const { return m_item->getPath(); }
+    virtual std::string getTitle() const { return m_item->getTitle(); }
+    virtual std::string getMimeType() const { return m_item->getMimeType(); }
+    virtual std::unique_ptr<zim::writer::ContentProvider> getContentProvider() const
+    {
+      return std::unique_ptr<zim::writer::ContentProvider>(
+          new StringContentProvider(m_content));
+    }
+
+  private:
+    std::shared_ptr<zim::writer::Item> m_item;
+    std::shared_ptr<const std::string> m_content;
+};
+
+} // namespace
+
+void CreatorDedup::addItem(zim::writer::Creator& creator,
+                           const std::shared_ptr<zim::writer::Item>& item,
+                           CreatorStats& stats)
+{
+  std::unique_ptr<zim::writer::ContentProvider> provider = item->getContentProvider();
+  const zim::size_type size = provider->getSize();
+  if (size == 0 || size > m_maxSize) {
+    // provider is dropped unread: account its content ourselves
+    if (dynamic_cast<CountingContentProvider*>(provider.get()))
+      stats.addBytesIn(size);
+    provider.reset();
+    creator.addItem(item);
+    return;
+  }
+
+  auto content = std::make_shared<std::string>();
+  content->reserve(size);
+  while (true) {
+    const zim::Blob blob = provider->feed();
+    if (blob.size() == 0)
+      break;
+    content->append(blob.data(), blob.size());
+  }
+  provider.reset();
+  if (content->size() != size)
+    throw std::runtime_error("Content size of " + item->getPath()
+        + " differs from its provider's size");
+
+  Key key{xxh64(content->data(), content->size(), 0),
+          xxh64(content->data(), content->size(), XXH_PRIME1),
+          size,
+          item->getMimeType()};
+  const std::string path = item->getPath();
+  ++m_itemsHashed;
+
+  std::string target;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inserted = m_paths.emplace(std::move(key), path);
+    if (!inserted.second)
+      target = inserted.first->second;
+  }
+  if (target.empty()) {
+    creator.addItem(std::make_shared<DedupWriterItem>(item, content));
+    return;
+  }
+  creator.addRedirection(path, item->getTitle(), target);
+  ++m_duplicates;
+  m_bytesSaved += size;
+}
+
+CreatorDedupSnapshot CreatorDedup::snapshot() const
+{
+  return CreatorDedupSnapshot{m_itemsHashed, m_duplicates, m_bytesSaved};
+}
+
+/*
+#########################
+#  Native Writer Items  #
+#########################
+*/
+
+zim::Blob CountingContentProvider::feed()
+{
+  zim::Blob blob = m_provider->feed();
+  m_stats->addBytesIn(blob.size());
+  return blob;
+}
+
+zim::Blob StringContentProvider::feed()
+{
+  if (m_fed)
+    return zim::Blob();
+  m_fed = true;
+  return zim::Blob(m_content->data(), m_content->size());
+}
+
+static const zim::size_type FILE_CHUNK_SIZE = 4 * 1024 * 1024;
+
+FileContentProvider::FileContentProvider(const std::string& filepath, zim::size_type size)
+  : m_filepath(filepath),
+    m_size(size),
+    m_offset(0),
+    m_fd(-1),
+    m_map(nullptr)
+{}
+
+FileContentProvider::~FileContentProvider()
+{
+  if (m_map)
+    ::munmap(m_map, m_size);
+  if (m_fd >= 0)
+    ::close(m_fd);
+}
+
+void FileContentProvider::open()
+{
+  m_fd = ::open(m_filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (m_fd < 0)
+    throw std::runtime_error("Unable to open " + m_filepath + ": " + std::strerror(errno));
+
+  struct stat st;
+  if (::fstat(m_fd, &st) != 0 || zim::size_type(st.st_size) < m_size)
+    throw std::runtime_error(m_filepath + " is smaller than expected");
+
+  void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (map != MAP_FAILED) {
+    m_map = static_cast<char*>(map);
+#if defined(MADV_SEQUENTIAL)
+    ::madvise(map, m_size, MADV_SEQUENTIAL);
+#endif
+  } else {
+    m_buffer.reset(new char[FILE_CHUNK_SIZE]);
+  }
+}
+
+zim::Blob FileContentProvider::feed()
+{
+  if (m_offset >= m_size)
+    return zim::Blob();
+
+  // opened on first feed only, as items may wait a long time in creator's queue
+  if (m_fd < 0)
+    open();
+
+  const zim::size_type toRead = std::min(FILE_CHUNK_SIZE, m_size - m_offset);
+  if (m_map) {
+    const zim::Blob blob(m_map + m_offset, toRead);
+    m_offset += toRead;
+    return blob;
+  }
+
+  zim::size_type done = 0;
+  while (done < toRead) {
+    const ssize_t ret = ::pread(m_fd, m_buffer.get() + done, toRead - done, m_offset + done);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret < 0)
+      throw std::runtime_error("Error reading " + m_filepath + ": " + std::strerror(errno));
+    if (ret == 0)
+      throw std::runtime_error(m_filepath + " is smaller than expected");
+    done += ret;
+  }
+  m_offset += done;
+  return zim::Blob(m_buffer.get(), done);
+}
+
+StaticWriterItem::StaticWriterItem(const std::string& path, const std::string& title,
+                                   const std::string& mimetype, const std::string& content,
+                                   bool isFile)
+  : m_path(path),
+    m_title(title),
+    m_mimetype(mimetype),
+    m_size(0)
+{
+  if (isFile) {
+    struct stat st;
+    if (::stat(content.c_str(), &st) != 0)
+      throw std::ios_base::failure("Unable to read " + content + ": " + std::strerror(errno));
+    m_filepath = content;
+    m_size = st.st_size;
+  } else {
+    m_content = std::make_shared<const std::string>(content);
+    m_size = m_content->size();
+  }
+}
+
+std::unique_ptr<zim::writer::ContentProvider>
+StaticWriterItem::getContentProvider() const
+{
+  if (m_content)
+    return std::unique_ptr<zim::writer::ContentProvider>(new StringContentProvider(m_content));
+  return std::unique_ptr<zim::writer::ContentProvider>(new FileContentProvider(m_filepath, m_size));
+}
+
+/*
+#########################
+#        Archive        #
+#########################
+*/
+
+void ZimArchive::getEntriesByPath(const std::vector<std::string>& paths,
+                                  zim::entry_index_type* indexes,
+                                  unsigned char* redirects,
+                                  unsigned char* missing) const
+{
+  for (size_t i = 0; i < paths.size(); ++i) {
+    try {
+      const zim::Entry entry = zim::Archive::getEntryByPath(paths[i]);
+      indexes[i] = entry.getIndex();
+      redirects[i] = entry.isRedirect();
+    } catch (const zim::EntryNotFound&) {
+      // other errors (format, I/O) are not missing entries: propagated
+      missing[i] = 1;
+    }
+  }
+}
+
+void ZimArchive::getEntriesByIndex(const std::vector<zim::entry_index_type>& idxs,
+                                   zim::entry_index_type* indexes,
+                                   unsigned char* redirects,
+                                   unsigned char* missing) const
+{
+  for (size_t i = 0; i < idxs.size(); ++i) {
+    try {
+      const zim::Entry entry = zim::Archive::getEntryByPath(idxs[i]);
+      indexes[i] = entry.getIndex();
+      redirects[i] = entry.isRedirect();
+    } catch (const std::out_of_range&) {
+      missing[i] = 1;
+    }
+  }
+}
+
+std::vector<std::pair<std::string, zim::Blob>>
+ZimArchive::getMetadataSnapshot(const std::vector<std::string>& names) const
+{
+  const std::vector<std::string> keys = names.empty() ? getMetadataKeys() : names;
+  std::vector<std::pair<std::string, zim::Blob>> snapshot;
+  snapshot.reserve(keys.size());
+  for (const auto& key : keys) {
+    try {
+      snapshot.emplace_back(key, zim::Archive::getMetadataItem(key).getData());
+    } catch (const zim::EntryNotFound&) {
+      // no such metadata
+    }
+  }
+  return snapshot;
+}
+
+namespace {
+
+std::mutex archivesMutex;
+std::map<std::string, std::weak_ptr<ZimArchive>> sharedArchives;
+
+// ZIM header, as in https://wiki.openzim.org/wiki/ZIM_file_format#Header
+const size_t ZIM_HEADER_SIZE = 80;
+const uint32_t ZIM_MAGIC = 72173914;
+
+uint32_t readUint32(const unsigned char* data)
+{
+  return uint32_t(data[0]) | uint32_t(data[1]) << 8
+       | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+uint64_t readUint64(const unsigned char* data)
+{
+  return uint64_t(readUint32(data)) | uint64_t(readUint32(data + 4)) << 32;
+}
+
+// Readers/writer lock (std::shared_mutex needs C++17): any number of
+// shared owners, or a single exclusive one. Exclusive lockers waiting
+// take precedence over new shared ones.
+class SharedMutex
+{
+  public:
+    void lockShared()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return !m_exclusive && !m_exclusiveWaiting; });
+      ++m_shared;
+    }
+    void unlockShared()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (--m_shared == 0)
+        m_cond.notify_all();
+    }
+    void lock()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      ++m_exclusiveWaiting;
+      m_cond.wait(lock, [this] { return !m_exclusive && !m_shared; });
+      --m_exclusiveWaiting;
+      m_exclusive = true;
+    }
+    void unlock()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_exclusive = false;
+      m_cond.notify_all();
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    size_t m_shared = 0;
+    size_t m_exclusiveWaiting = 0;
+    bool m_exclusive = false;
+};
+
+// libzim reads its cache sizes from the environment when opening an
+// archive. Our opens hold this lock shared (so they run in parallel), and
+// ScopedEnv exclusively while it changes the environment: none of our
+// opens reads it meanwhile (concurrent setenv/getenv is undefined).
+SharedMutex envMutex;
+
+class SharedEnvLock
+{
+  public:
+    SharedEnvLock() { envMutex.lockShared(); }
+    ~SharedEnvLock() { envMutex.unlockShared(); }
+    SharedEnvLock(const SharedEnvLock&) = delete;
+    SharedEnvLock& operator=(const SharedEnvLock&) = delete;
+};
+
+// Set environment variables for the lifetime of the object, holding
+// envMutex exclusively
+class ScopedEnv
+{
+  public:
+    ScopedEnv() { envMutex.lock(); }
+    ~ScopedEnv()
+    {
+      for (const auto& var : m_saved) {
+        if (var.second.first)
+          ::setenv(var.first.c_str(), var.second.second.c_str(), 1);
+        else
+          ::unsetenv(var.first.c_str());
+      }
+      envMutex.unlock();
+    }
+    ScopedEnv(const ScopedEnv&) = delete;
+    ScopedEnv& operator=(const ScopedEnv&) = delete;
+
+    void set(const std::string& name, size_t value)
+    {
+      if (!value)
+        return;
+      const char* previous = ::getenv(name.c_str());
+      m_saved.emplace_back(name, std::make_pair(previous != nullptr,
+                                                std::string(previous ? previous : "")));
+      ::setenv(name.c_str(), std::to_string(value).c_str(), 1);
+    }
+
+  private:
+    std::vector<std::pair<std::string, std::pair<bool, std::string>>> m_saved;
+};
+
+std::shared_ptr<ZimArchive> newArchive(const std::string& filename,
+                                       size_t clusterCacheSize,
+                                       size_t direntCacheSize)
+{
+  if (!clusterCacheSize && !direntCacheSize) {
+    SharedEnvLock lock;
+    return std::make_shared<ZimArchive>(filename);
+  }
+
+  ScopedEnv env;
+  env.set("ZIM_CLUSTERCACHE", clusterCacheSize);
+  env.set("ZIM_DIRENTCACHE", direntCacheSize);
+  return std::make_shared<ZimArchive>(filename);
+}
+
+} // namespace
+
+std::shared_ptr<ZimArchive> openArchive(const std::string& filename,
+                                        const std::string& key,
+                                        size_t clusterCacheSize,
+                                        size_t direntCacheSize)
+{
+  if (key.empty())
+    return newArchive(filename, clusterCacheSize, direntCacheSize);
+
+  {
+    std::lock_guard<std::mutex> lock(archivesMutex);
+    auto it = sharedArchives.find(key);
+    if (it != sharedArchives.end()) {
+      if (auto archive = it->second.lock())
+        return archive;
+    }
+  }
+
+  // open without the lock: other archives can be opened meanwhile
+  auto archive = newArchive(filename, clusterCacheSize, direntCacheSize);
+
+  std::lock_guard<std::mutex> lock(archivesMutex);
+  auto& slot = sharedArchives[key];
+  if (auto other = slot.lock())
+    return other;  // opened by another thread meanwhile
+  slot = archive;
+  // forget closed archives
+  for (auto it = sharedArchives.begin(); it != sharedArchives.end();) {
+    if (it->second.expired())
+      it = sharedArchives.erase(it);
+    else
+      ++it;
+  }
+  return archive;
+}
+
+// End of the mime list starting at mimeListPos: the list directly follows
+// the header, so it ends at the first section (or cluster) after it.
+uint64_t mimeListEnd(int fd, const unsigned char* header, uint64_t fileSize)
+{
+  const uint64_t mimeListPos = readUint64(header + 56);
+  const uint64_t clusterPtrPos = readUint64(header + 48);
+  uint64_t end = fileSize;
+  const auto bound = [&](uint64_t pos) {
+    if (pos > mimeListPos && pos < end)
+      end = pos;
+  };
+  bound(readUint64(header + 32));  // path pointers
+  bound(readUint64(header + 40));  // title pointers
+  bound(clusterPtrPos);
+  // as libzim: checksum position is only in headers ending before mime list
+  if (mimeListPos >= ZIM_HEADER_SIZE)
+    bound(readUint64(header + 72));
+  unsigned char pointer[8];
+  if (readUint32(header + 28)
+      && ::pread(fd, pointer, sizeof(pointer), clusterPtrPos) == ssize_t(sizeof(pointer)))
+    bound(readUint64(pointer));  // first cluster
+  return std::max(end, mimeListPos);
+}
+
+bool prefaultArchive(const std::string& filename)
+{
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  unsigned char header[ZIM_HEADER_SIZE];
+  struct stat st;
+  const bool valid = ::pread(fd, header, sizeof(header), 0) == ssize_t(sizeof(header))
+                  && readUint32(header) == ZIM_MAGIC
+                  && ::fstat(fd, &st) == 0;
+  if (valid) {
+    const uint64_t entryCount = readUint32(header + 24);
+    const uint64_t clusterCount = readUint32(header + 28);
+    const uint64_t pathPtrPos = readUint64(header + 32);
+    const uint64_t titlePtrPos = readUint64(header + 40);
+    const uint64_t clusterPtrPos = readUint64(header + 48);
+    const uint64_t mimeListPos = readUint64(header + 56);
+#if defined(POSIX_FADV_WILLNEED)
+    const uint64_t mimeListSize = mimeListEnd(fd, header, st.st_size) - mimeListPos;
+    if (mimeListSize)
+      ::posix_fadvise(fd, mimeListPos, mimeListSize, POSIX_FADV_WILLNEED);
+    ::posix_fadvise(fd, pathPtrPos, entryCount * 8, POSIX_FADV_WILLNEED);
+    ::posix_fadvise(fd, titlePtrPos, entryCount * 4, POSIX_FADV_WILLNEED);
+    ::posix_fadvise(fd, clusterPtrPos, clusterCount * 8, POSIX_FADV_WILLNEED);
+#else
+    (void)entryCount; (void)clusterCount; (void)pathPtrPos;
+    (void)titlePtrPos; (void)clusterPtrPos; (void)mimeListPos;
+#endif
+  }
+  ::close(fd);
+  return valid;
+}
+
+std::vector<std::string> readMimeTypes(const std::string& filename)
+{
+  // split archives: header and mime list are in the first part
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    fd = ::open((filename + "aa").c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw std::runtime_error("Cannot open " + filename);
+
+  std::vector<std::string> mimeTypes;
+  std::string error;
+  unsigned char header[ZIM_HEADER_SIZE];
+  struct stat st;
+  if (::pread(fd, header, sizeof(header), 0) != ssize_t(sizeof(header))
+      || readUint32(header) != ZIM_MAGIC || ::fstat(fd, &st) != 0) {
+    error = "Not a ZIM file: " + filename;
+  } else {
+    const uint64_t mimeListPos = readUint64(header + 56);
+    std::vector<char> buffer(mimeListEnd(fd, header, st.st_size) - mimeListPos);
+    const ssize_t size = ::pread(fd, buffer.data(), buffer.size(), mimeListPos);
+    // zero terminated strings, up to an empty one
+    ssize_t start = 0;
+    for (ssize_t pos = 0; pos < size; ++pos) {
+      if (buffer[pos])
+        continue;
+      if (pos == start)
+        break;
+      mimeTypes.emplace_back(buffer.data() + start, pos - start);
+      start = pos + 1;
+    }
+    if (size < 0)
+      error = "Cannot read mime types of " + filename;
+  }
+  ::close(fd);
+  if (!error.empty())
+    throw std::runtime_error(error);
+  return mimeTypes;
+}
+
+
+/*
+#########################
+#       Task Pool       #
+#########################
+*/
+
+ZimTaskPool::ZimTaskPool(size_t nbThreads)
+  : m_stop(false)
+{
+  if (::pipe(m_pipe) != 0)
+    throw std::system_error(errno, std::generic_category(), "Can't create pipe");
+  for (int fd : m_pipe) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  for (size_t i = 0; i < std::max<size_t>(nbThreads, 1); ++i)
+    m_threads.emplace_back(&ZimTaskPool::run, this);
+}
+
+ZimTaskPool::~ZimTaskPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    m_stop = true;
+  }
+  m_tasksCond.notify_all();
+  for (auto& thread : m_threads)
+    thread.join();
+  ::close(m_pipe[0]);
+  ::close(m_pipe[1]);
+}
+
+void ZimTaskPool::getEntryByPath(uint64_t id,
+                                 const std::shared_ptr<ZimArchive>& archive,
+                                 const std::string& path,
+                                 bool withItem)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    m_tasks.push_back(Task{id, archive, path, withItem});
+  }
+  m_tasksCond.notify_one();
+}
+
+void ZimTaskPool::pushResult(ZimTaskResult&& result)
+{
+  std::lock_guard<std::mutex> lock(m_resultsMutex);
+  // pipe holds a byte iff there are results (see popResults)
+  if (m_results.empty()) {
+    const char byte = 0;
+    while (::write(m_pipe[1], &byte, 1) < 0 && errno == EINTR) {}
+  }
+  m_results.push_back(std::move(result));
+}
+
+std::vector<ZimTaskResult> ZimTaskPool::popResults()
+{
+  std::vector<ZimTaskResult> results;
+  std::lock_guard<std::mutex> lock(m_resultsMutex);
+  results.swap(m_results);
+  char buffer[64];
+  while (::read(m_pipe[0], buffer, sizeof(buffer)) > 0) {}
+  return results;
+}
+
+void ZimTaskPool::run()
+{
+  while (true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(m_tasksMutex);
+      m_tasksCond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop)
+        return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    ZimTaskResult result;
+    result.id = task.id;
+    result.withItem = task.withItem;
+    result.notFound = false;
+    try {
+      result.entry = task.archive->getEntryByPath(task.path);
+    } catch (const zim::EntryNotFound& e) {
+      result.notFound = true;
+      result.error = e.what();
+    } catch (const std::exception& e) {
+      // format or I/O error: must not escape (and terminate) the thread
+      result.error = e.what();
+    } catch (...) {
+      result.error = "Unknown error looking up " + task.path;
+    }
+    try {
+      if (task.withItem && result.error.empty()) {
+        result.item = result.entry.getItem(true);
+        // decompress here, not in the event loop
+        result.content = result.item.getData(0);
+      }
+    } catch (const std::exception& e) {
+      result.error = e.what();
+    } catch (...) {
+      result.error = "Unknown error reading " + task.path;
+    }
+    // archive may be closed (in Python) meanwhile
+    task.archive.reset();
+    pushResult(std::move(result));
+  }
+}
+
+namespace {
+
+// paths waiting to be prefetched, beyond which prefetch() drops them
+const size_t PREFETCH_MAX_PENDING = 4096;
+
+void adviseFileRange(const std::string& path, zim::offset_type offset, zim::size_type size)
+{
+#if defined(POSIX_FADV_WILLNEED)
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  // readahead is started now and outlives the descriptor
+  ::posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+  ::close(fd);
+#else
+  (void)path; (void)offset; (void)size;
+#endif
+}
+
+class Prefetcher
+{
+  public:
+    Prefetcher()
+      : m_stop(false),
+        m_thread(&Prefetcher::run, this)
+    {}
+
+    ~Prefetcher()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_cond.notify_all();
+      m_thread.join();
+    }
+
+    size_t push(const std::shared_ptr<ZimArchive>& archive,
+                const std::vector<std::string>& paths,
+                bool adviseFile)
+    {
+      size_t queued = 0;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& path : paths) {
+          if (m_tasks.size() >= PREFETCH_MAX_PENDING)
+            break;
+          m_tasks.push_back(Task{archive, path, adviseFile});
+          ++queued;
+        }
+      }
+      if (queued)
+        m_cond.notify_one();
+      return queued;
+    }
+
+  private:
+    struct Task
+    {
+      std::shared_ptr<ZimArchive> archive;
+      std::string path;
+      bool adviseFile;
+    };
+
+    void run()
+    {
+      while (true) {
+        Task task;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_cond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+          if (m_stop)
+            return;
+          task = std::move(m_tasks.front());
+          m_tasks.pop_front();
+        }
+        try {
+          const ZimItem item = task.archive->getEntryByPath(task.path).getItem(true);
+          const auto info = item.getDirectAccessInformation();
+          if (info.first.empty()) {
+            // reading (the start of) the blob decompresses its cluster
+            if (item.getSize())
+              item.getData(0, 1);
+          } else if (task.adviseFile) {
+            adviseFileRange(info.first, info.second, item.getSize());
+          }
+        } catch (const std::exception&) {
+          // missing entry or bad cluster: reported when actually read
+        }
+      }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Task> m_tasks;
+    bool m_stop;
+    std::thread m_thread;
+};
+
+} // namespace
+
+size_t prefetchEntries(const std::shared_ptr<ZimArchive>& archive,
+                       const std::vector<std::string>& paths,
+                       bool adviseFile)
+{
+  // started on first use, stopped at exit
+  static Prefetcher prefetcher;
+  return prefetcher.push(archive, paths, adviseFile);
+}
+
+
+/*
+#########################
+#        Checker        #
+#########################
+*/
+
+namespace {
+
+// MD5 (RFC 1321), as libzim's checksum
+class Md5
+{
+  public:
+    Md5()
+      : m_state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476},
+        m_size(0),
+        m_bufferSize(0)
+    {}
+
+    void update(const char* data, size_t size)
+    {
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+      m_size += size;
+      if (m_bufferSize) {
+        const size_t n = std::min(size, sizeof(m_buffer) - m_bufferSize);
+        std::memcpy(m_buffer + m_bufferSize, bytes, n);
+        m_bufferSize += n;
+        bytes += n;
+        size -= n;
+        if (m_bufferSize < sizeof(m_buffer))
+          return;
+        transform(m_buffer);
+        m_bufferSize = 0;
+      }
+      for (; size >= sizeof(m_buffer); bytes += sizeof(m_buffer), size -= sizeof(m_buffer))
+        transform(bytes);
+      std::memcpy(m_buffer, bytes, size);
+      m_bufferSize = size;
+    }
+
+    // 16 bytes digest ; object can't be updated afterwards
+    std::string digest()
+    {
+      const uint64_t bits = m_size * 8;
+      unsigned char padding[72] = {0x80};
+      const size_t paddingSize = (m_bufferSize < 56 ? 56 : 120) - m_bufferSize;
+      for (int i = 0; i < 8; ++i)
+        padding[paddingSize + i] = static_cast<unsigned char>(bits >> (8 * i));
+      update(reinterpret_cast<const char*>(padding), paddingSize + 8);
+
+      std::string result(16, '\0');
+      for (int i = 0; i < 16; ++i)
+        result[i] = static_cast<char>(m_state[i / 4] >> (8 * (i % 4)));
+      return result;
+    }
+
+  private:
+    static uint32_t rotate(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    void transform(const unsigned char* block)
+    {
+      static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+        0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+        0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+        0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+        0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+        0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+      static const int S[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+
+      uint32_t M[16];
+      for (int i = 0; i < 16; ++i) {
+        M[i] = uint32_t(block[i * 4]) | uint32_t(block[i * 4 + 1]) << 8
+             | uint32_t(block[i * 4 + 2]) << 16 | uint32_t(block[i * 4 + 3]) << 24;
+      }
+
+      uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+      for (int i = 0; i < 64; ++i) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+          f = (b & c) | (~b & d);
+          g = i;
+        } else if (i < 32) {
+          f = (d & b) | (~d & c);
+          g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+          f = b ^ c ^ d;
+          g = (3 * i + 5) % 16;
+        } else {
+          f = c ^ (b | ~d);
+          g = (7 * i) % 16;
+        }
+        const uint32_t next = b + rotate(a + f + K[i] + M[g], S[i]);
+        a = d;
+        d = c;
+        c = b;
+        b = next;
+      }
+      m_state[0] += a;
+      m_state[1] += b;
+      m_state[2] += c;
+      m_state[3] += d;
+    }
+
+    uint32_t m_state[4];
+    uint64_t m_size;
+    unsigned char m_buffer[64];
+    size_t m_bufferSize;
+};
+
+const size_t CHECK_CHUNK_SIZE = 4 * 1024 * 1024;
+// chunks read ahead of the hashing
+const size_t CHECK_READ_AHEAD = 4;
+
+// Parts of an archive, read as a single file
+class SplitFile
+{
+  public:
+    explicit SplitFile(const std::vector<std::string>& parts, bool sequential = true)
+    {
+      for (const auto& part : parts) {
+        const int fd = ::open(part.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+          if (fd >= 0)
+            ::close(fd);
+          throw std::ios_base::failure("Cannot open " + part + ": " + std::strerror(errno));
+        }
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (sequential)
+          ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        m_parts.emplace_back(fd, st.st_size);
+      }
+    }
+
+    ~SplitFile()
+    {
+      for (const auto& part : m_parts)
+        ::close(part.first);
+    }
+
+    uint64_t size() const
+    {
+      uint64_t size = 0;
+      for (const auto& part : m_parts)
+        size += part.second;
+      return size;
+    }
+
+    void read(char* dest, uint64_t offset, size_t size) const
+    {
+      for (const auto& part : m_parts) {
+        if (!size)
+          return;
+        if (offset >= part.second) {
+          offset -= part.second;
+          continue;
+        }
+        const size_t partSize = std::min<uint64_t>(size, part.second - offset);
+        size_t done = 0;
+        while (done < partSize) {
+          const ssize_t n = ::pread(part.first, dest + done, partSize - done, offset + done);
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            throw std::ios_base::failure("Error reading archive");
+          done += n;
+        }
+        dest += partSize;
+        size -= partSize;
+        offset = 0;
+      }
+      if (size)
+        throw std::ios_base::failure("Unexpected end of archive");
+    }
+
+  private:
+    std::vector<std::pair<int, uint64_t>> m_parts;
+};
+
+} // namespace
+
+ZimChecker::ZimChecker(const std::vector<std::string>& parts)
+  : m_parts(parts),
+    m_processed(0),
+    m_total(0),
+    m_cancelled(false),
+    m_status(NOT_STARTED)
+{}
+
+ZimChecker::~ZimChecker()
+{
+  cancel();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void ZimChecker::start()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_status != NOT_STARTED)
+    throw std::runtime_error("Check already started");
+  m_status = RUNNING;
+  m_thread = std::thread(&ZimChecker::run, this);
+}
+
+void ZimChecker::cancel()
+{
+  m_cancelled = true;
+}
+
+bool ZimChecker::wait(double timeout)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  const auto ended = [this] { return m_status != RUNNING; };
+  if (timeout < 0) {
+    m_ended.wait(lock, ended);
+    return true;
+  }
+  return m_ended.wait_for(lock, std::chrono::duration<double>(timeout), ended);
+}
+
+ZimChecker::Status ZimChecker::getStatus() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_status;
+}
+
+std::string ZimChecker::getError() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_error;
+}
+
+void ZimChecker::run()
+{
+  Status status;
+  std::string error;
+  try {
+    status = verify();
+  } catch (const std::exception& e) {
+    status = FAILED;
+    error = e.what();
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_status = status;
+    m_error = error;
+  }
+  m_ended.notify_all();
+}
+
+ZimChecker::Status ZimChecker::verify()
+{
+  const SplitFile file(m_parts);
+  const uint64_t fileSize = file.size();
+
+  unsigned char header[ZIM_HEADER_SIZE];
+  if (fileSize < sizeof(header))
+    throw std::runtime_error("Not a ZIM file");
+  file.read(reinterpret_cast<char*>(header), 0, sizeof(header));
+  if (readUint32(header) != ZIM_MAGIC)
+    throw std::runtime_error("Not a ZIM file");
+
+  // as libzim: checksum position is only in headers ending before mime
+  // list (older 72 bytes headers have none)
+  if (readUint64(header + 56) < ZIM_HEADER_SIZE)
+    return NO_CHECKSUM;
+  // MD5 of [0, checksumPos) is stored at checksumPos
+  const uint64_t checksumPos = readUint64(header + 72);
+  if (checksumPos == 0)
+    return NO_CHECKSUM;
+  if (checksumPos + 16 > fileSize)
+    return INVALID;
+  std::string expected(16, '\0');
+  file.read(&expected[0], checksumPos, expected.size());
+  m_total = checksumPos;
+
+  // reader thread fills chunks, hashed here in order
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::vector<char>> chunks;
+  bool readDone = false;
+  std::exception_ptr readError;
+
+  std::thread reader([&] {
+    try {
+      for (uint64_t offset = 0; offset < checksumPos && !m_cancelled;) {
+        std::vector<char> chunk(std::min<uint64_t>(CHECK_CHUNK_SIZE, checksumPos - offset));
+        file.read(chunk.data(), offset, chunk.size());
+        offset += chunk.size();
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return chunks.size() < CHECK_READ_AHEAD || m_cancelled; });
+        chunks.push_back(std::move(chunk));
+        cond.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      readError = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    readDone = true;
+    cond.notify_all();
+  });
+
+  Md5 md5;
+  while (true) {
+    std::vector<char> chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return !chunks.empty() || readDone; });
+      if (chunks.empty())
+        break;
+      chunk = std::move(chunks.front());
+      chunks.pop_front();
+      cond.notify_all();
+    }
+    if (m_cancelled)
+      continue;  // drain until reader stops
+    md5.update(chunk.data(), chunk.size());
+    m_processed += chunk.size();
+  }
+  reader.join();
+
+  if (readError)
+    std::rethrow_exception(readError);
+  if (m_cancelled)
+    return CANCELLED;
+  return md5.digest() == expected ? VALID : INVALID;
+}
+
+
+/*
+#########################
+#     Header Reader     #
+#########################
+*/
+
+namespace {
+
+// dirent mimetype values of entries without content
+const uint16_t DIRENT_REDIRECT = 0xffff;
+const uint16_t DIRENT_LINKTARGET = 0xfffe;
+const uint16_t DIRENT_DELETED = 0xfffd;
+// dirents are read by blocks, enough for most paths and titles
+const size_t DIRENT_READ_SIZE = 512;
+const size_t DIRENT_MAX_SIZE = 64 * 1024;
+// cluster info byte: compression (low bits) and 8 bytes offsets flag
+const unsigned char CLUSTER_COMPRESSION_MASK = 0x0f;
+const unsigned char CLUSTER_EXTENDED = 0x10;
+
+struct Dirent
+{
+  uint16_t mimetype;
+  char ns;
+  std::string path;
+  // of items (mimetype < DIRENT_DELETED) only
+  uint32_t cluster = 0;
+  uint32_t blob = 0;
+};
+
+// Path-ordered dirents of an archive, read on demand
+class DirentReader
+{
+  public:
+    DirentReader(const SplitFile& file, uint64_t pathPtrPos, uint32_t entryCount)
+      : m_file(file),
+        m_size(file.size()),
+        m_pathPtrPos(pathPtrPos),
+        m_entryCount(entryCount)
+    {}
+
+    uint32_t size() const { return m_entryCount; }
+
+    Dirent get(uint32_t index) const
+    {
+      unsigned char pointer[8];
+      m_file.read(reinterpret_cast<char*>(pointer), m_pathPtrPos + uint64_t(index) * 8, 8);
+      const uint64_t offset = readUint64(pointer);
+      if (offset >= m_size)
+        throw std::runtime_error("Invalid dirent pointer");
+
+      for (size_t readSize = DIRENT_READ_SIZE;; readSize = DIRENT_MAX_SIZE) {
+        std::vector<char> buffer(std::min<uint64_t>(readSize, m_size - offset));
+        m_file.read(buffer.data(), offset, buffer.size());
+        const auto* data = reinterpret_cast<const unsigned char*>(buffer.data());
+        if (buffer.size() < 8)
+          throw std::runtime_error("Invalid dirent");
+        Dirent dirent;
+        dirent.mimetype = uint16_t(data[0]) | uint16_t(data[1]) << 8;
+        dirent.ns = buffer[3];
+        if (dirent.mimetype < DIRENT_DELETED && buffer.size() >= 16) {
+          dirent.cluster = readUint32(data + 8);
+          dirent.blob = readUint32(data + 12);
+        }
+        size_t pathPos = 16;
+        if (dirent.mimetype == DIRENT_REDIRECT)
+          pathPos = 12;
+        else if (dirent.mimetype == DIRENT_LINKTARGET || dirent.mimetype == DIRENT_DELETED)
+          pathPos = 8;
+        const auto pathEnd = pathPos < buffer.size()
+                           ? std::find(buffer.begin() + pathPos, buffer.end(), '\0')
+                           : buffer.end();
+        if (pathEnd != buffer.end()) {
+          dirent.path.assign(buffer.begin() + pathPos, pathEnd);
+          return dirent;
+        }
+        if (readSize == DIRENT_MAX_SIZE || buffer.size() < readSize)
+          throw std::runtime_error("Invalid dirent");
+      }
+    }
+
+    // Index of the first dirent not before (ns, path)
+    uint32_t lowerBound(char ns, const std::string& path) const
+    {
+      uint32_t first = 0;
+      uint32_t count = m_entryCount;
+      while (count) {
+        const uint32_t step = count / 2;
+        const Dirent dirent = get(first + step);
+        if (dirent.ns < ns || (dirent.ns == ns && dirent.path < path)) {
+          first += step + 1;
+          count -= step + 1;
+        } else {
+          count = step;
+        }
+      }
+      return first;
+    }
+
+    bool hasItem(char ns, const std::string& path) const
+    {
+      const uint32_t index = lowerBound(ns, path);
+      if (index >= m_entryCount)
+        return false;
+      const Dirent dirent = get(index);
+      return dirent.ns == ns && dirent.path == path && dirent.mimetype < DIRENT_DELETED;
+    }
+
+  private:
+    const SplitFile& m_file;
+    const uint64_t m_size;
+    const uint64_t m_pathPtrPos;
+    const uint32_t m_entryCount;
+};
+
+// Content of blob `blobIndex` of cluster `clusterIndex`, if the cluster is
+// not compressed (false otherwise)
+bool readUncompressedBlob(const SplitFile& file, uint64_t clusterPtrPos,
+                          uint32_t clusterCount, uint32_t clusterIndex,
+                          uint32_t blobIndex, std::string& content)
+{
+  if (clusterIndex >= clusterCount)
+    throw std::runtime_error("Invalid cluster number");
+  const uint64_t size = file.size();
+  unsigned char buffer[16];
+  file.read(reinterpret_cast<char*>(buffer), clusterPtrPos + uint64_t(clusterIndex) * 8, 8);
+  const uint64_t clusterPos = readUint64(buffer);
+  if (clusterPos >= size)
+    throw std::runtime_error("Invalid cluster pointer");
+
+  file.read(reinterpret_cast<char*>(buffer), clusterPos, 1);
+  const unsigned char compression = buffer[0] & CLUSTER_COMPRESSION_MASK;
+  if (compression > 1)  // 0 (old) and 1: no compression
+    return false;
+  const uint64_t offsetSize = (buffer[0] & CLUSTER_EXTENDED) ? 8 : 4;
+
+  // offsets (from after the info byte) of the blobs, then of their end
+  const uint64_t offsetsPos = clusterPos + 1;
+  const auto readOffset = [&](uint64_t index) {
+    if (offsetsPos + (index + 1) * offsetSize > size)
+      throw std::runtime_error("Invalid cluster");
+    file.read(reinterpret_cast<char*>(buffer), offsetsPos + index * offsetSize, offsetSize);
+    return offsetSize == 8 ? readUint64(buffer) : uint64_t(readUint32(buffer));
+  };
+  const uint64_t blobCount = readOffset(0) / offsetSize - 1;
+  if (blobIndex >= blobCount)
+    throw std::runtime_error("Invalid blob number");
+  const uint64_t begin = readOffset(blobIndex);
+  const uint64_t end = readOffset(blobIndex + 1);
+  if (end < begin || offsetsPos + end > size)
+    throw std::runtime_error("Invalid blob offsets");
+  content.resize(end - begin);
+  if (!content.empty())
+    file.read(&content[0], offsetsPos + begin, content.size());
+  return true;
+}
+
+ZimHeaderInfo readZimHeader(const std::vector<std::string>& parts,
+                            const std::vector<std::string>& metadataNames)
+{
+  // requested metadata that must be read through libzim
+  std::vector<std::string> compressedNames;
+  ZimHeaderInfo info;
+  try {
+    const SplitFile file(parts, false);
+    info.size = file.size();
+    unsigned char header[ZIM_HEADER_SIZE];
+    if (info.size < sizeof(header))
+      throw std::runtime_error("Not a ZIM file");
+    file.read(reinterpret_cast<char*>(header), 0, sizeof(header));
+    if (readUint32(header) != ZIM_MAGIC)
+      throw std::runtime_error("Not a ZIM file");
+
+    info.majorVersion = uint16_t(header[4]) | uint16_t(header[5]) << 8;
+    info.minorVersion = uint16_t(header[6]) | uint16_t(header[7]) << 8;
+    info.uuid.assign(reinterpret_cast<const char*>(header + 8), 16);
+    info.entryCount = readUint32(header + 24);
+    info.clusterCount = readUint32(header + 28);
+    info.hasMainEntry = readUint32(header + 64) != 0xffffffff;
+    // as libzim: checksum position is only in headers ending before mime list
+    info.hasChecksum = readUint64(header + 56) >= ZIM_HEADER_SIZE;
+
+    const DirentReader dirents(file, readUint64(header + 32), info.entryCount);
+    for (uint32_t index = dirents.lowerBound('M', ""); index < dirents.size(); ++index) {
+      const Dirent dirent = dirents.get(index);
+      if (dirent.ns != 'M')
+        break;
+      info.metadataKeys.push_back(dirent.path);
+    }
+    // new namespace scheme, then old one
+    info.hasFulltextIndex = dirents.hasItem('X', "fulltext/xapian")
+                         || dirents.hasItem('Z', "/fulltextIndex/xapian");
+
+    const uint64_t clusterPtrPos = readUint64(header + 48);
+    for (const auto& name : metadataNames) {
+      const uint32_t index = dirents.lowerBound('M', name);
+      if (index >= dirents.size())
+        continue;
+      const Dirent dirent = dirents.get(index);
+      if (dirent.ns != 'M' || dirent.path != name || dirent.mimetype == DIRENT_DELETED
+          || dirent.mimetype == DIRENT_LINKTARGET)
+        continue;
+      std::string value;
+      if (dirent.mimetype != DIRENT_REDIRECT
+          && readUncompressedBlob(file, clusterPtrPos, info.clusterCount,
+                                  dirent.cluster, dirent.blob, value))
+        info.metadata.emplace_back(name, std::move(value));
+      else
+        compressedNames.push_back(name);  // or redirect: libzim resolves it
+    }
+  } catch (const std::exception& e) {
+    info.error = e.what();
+    return info;
+  }
+
+  if (compressedNames.empty())
+    return info;
+  try {
+    // decompression needs libzim (opened in parallel with other opens)
+    const std::string filename = parts.size() == 1 ? parts[0]
+                               : parts[0].substr(0, parts[0].size() - 2);
+    const zim::Archive archive = [&filename] {
+      SharedEnvLock lock;
+      return zim::Archive(filename);
+    }();
+    for (const auto& name : compressedNames)
+      info.metadata.emplace_back(name, archive.getMetadata(name));
+  } catch (const std::exception& e) {
+    info.error = e.what();
+  }
+  return info;
+}
+
+} // namespace
+
+std::vector<ZimHeaderInfo> readZimHeaders(const std::vector<std::vector<std::string>>& archives,
+                                          const std::vector<std::string>& metadataNames,
+                                          size_t nbThreads)
+{
+  std::vector<ZimHeaderInfo> infos(archives.size());
+  if (!nbThreads)
+    nbThreads = std::max(1u, std::thread::hardware_concurrency());
+  nbThreads = std::min(nbThreads, archives.size());
+
+  std::atomic<size_t> next(0);
+  const auto worker = [&] {
+    for (size_t index = next++; index < archives.size(); index = next++)
+      infos[index] = readZimHeader(archives[index], metadataNames);
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < nbThreads; ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads)
+    thread.join();
+  return infos;
+}
+
+/*
+#########################
+#         Item          #
+#########################
+*/
+
+namespace {
+
+// write() `size` bytes, stopping early only if `fd` would block.
+zim::size_type writeAll(int fd, const char* data, zim::size_type size, bool& wouldBlock)
+{
+  zim::size_type written = 0;
+  while (written < size) {
+    const ssize_t ret = ::write(fd, data + written, size - written);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        wouldBlock = true;
+        break;
+      }
+      throw std::runtime_error(std::string("Error writing content: ") + std::strerror(errno));
+    }
+    written += ret;
+  }
+  return written;
+}
+
+#if defined(__linux__)
+// sendfile() `size` bytes from `path` at `offset`.
+// Returns false (having sent nothing) if `fd` does not support sendfile.
+bool sendFileRange(int fd, const std::string& path, off_t offset,
+                   zim::size_type size, zim::size_type& sent, bool& wouldBlock)
+{
+  const int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return false;
+
+  int error = 0;
+  sent = 0;
+  while (sent < size) {
+    const ssize_t ret = ::sendfile(fd, in, &offset, size - sent);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      error = errno;
+      break;
+    }
+    if (ret == 0) {
+      error = EIO;  // archive file shorter than expected
+      break;
+    }
+    sent += ret;
+  }
+  ::close(in);
+
+  if (error == EAGAIN || error == EWOULDBLOCK)
+    wouldBlock = true;
+  if (!error || wouldBlock)
+    return true;
+  if (!sent && (error == EINVAL || error == ENOSYS))
+    return false;
+  throw std::runtime_error(std::string("Error sending content: ") + std::strerror(error));
+}
+#endif
+
+} // namespace
+
+zim::size_type ZimItem::sendTo(int fd, zim::offset_type offset, zim::size_type size,
+                               bool& wouldBlock) const
+{
+  wouldBlock = false;
+  const zim::size_type itemSize = getSize();
+  if (offset >= itemSize)
+    return 0;
+  size = std::min(size, itemSize - offset);
+
+#if defined(__linux__)
+  const auto info = getDirectAccessInformation();
+  zim::size_type sent = 0;
+  if (!info.first.empty()
+      && sendFileRange(fd, info.first, info.second + offset, size, sent, wouldBlock))
+    return sent;
+#endif
+
+  const zim::Blob blob = getData(offset, size);
+  return writeAll(fd, blob.data(), blob.size(), wouldBlock);
+}
+
+zim::size_type ZimItem::readInto(char* buffer, zim::offset_type offset, zim::size_type size) const
+{
+  const zim::size_type itemSize = getSize();
+  if (offset >= itemSize || !size)
+    return 0;
+  size = std::min(size, itemSize - offset);
+
+  const zim::Blob blob = getData(offset, size);
+  std::memcpy(buffer, blob.data(), blob.size());
+  return blob.size();
+}
+
+
+/*
+#########################
+#        Search         #
+#########################
+*/
+
+namespace {
+
+// Smallest number of results fetched by a run of the query
+const size_t MIN_SEARCH_WINDOW = 20;
+
+} // namespace
+
+ZimSearchResultSet::ZimSearchResultSet(const std::vector<ZimArchive>& archives,
+                                       const std::string& query,
+                                       bool suggestionMode)
+  : m_query(query),
+    m_suggestionMode(suggestionMode),
+    m_estimatedMatches(0),
+    m_started(false),
+    m_complete(false)
+{
+  for (size_t i = 0; i < archives.size(); ++i) {
+    // zim::Search skips archives without index and numbers results
+    // (get_fileIndex) among the others: don't pass those.
+    // A single archive is always passed as is (suggestions fallback).
+    if (archives.size() > 1
+        && !(suggestionMode ? archives[i].hasTitleIndex() : archives[i].hasFulltextIndex()))
+      continue;
+    m_archives.push_back(archives[i]);
+    m_archiveIndexes.push_back(i);
+  }
+}
+
+void ZimSearchResultSet::runQuery(size_t end, size_t snippetStart, size_t snippetEnd)
+{
+  // m_mutex must be held
+  m_search.reset(new ZimSearch(m_archives));
+  m_search->set_suggestion_mode(m_suggestionMode);
+  m_search->set_query(m_query);
+  m_search->set_range(0, end);
+
+  // begin() runs the actual Xapian query
+  size_t index = 0;
+  const auto endIt = m_search->end();
+  for (auto it = m_search->begin(); it != endIt; ++it, ++index) {
+    if (index < m_results.size())
+      continue;  // fetched by a previous run
+    const size_t fileIndex = m_archives.size() > 1 ? it.get_fileIndex() : 0;
+    const bool withSnippet = snippetStart <= index && index < snippetEnd;
+    m_results.push_back(ZimSearchResult{
+        it.get_path(),
+        it.get_title(),
+        it.get_score(),
+        m_archiveIndexes.at(fileIndex),
+        withSnippet,
+        withSnippet ? it.get_snippet() : std::string()});
+  }
+  m_estimatedMatches = m_search->get_matches_estimated();
+}
+
+void ZimSearchResultSet::fetch(size_t end, size_t snippetStart, bool withSnippets)
+{
+  // m_mutex must be held
+  if (m_complete || (m_started && end <= m_results.size()))
+    return;
+
+  const size_t start = m_results.size();
+  // zim::Search takes an int range
+  const size_t windowEnd = std::min<size_t>(
+      std::max({end, 2 * start, MIN_SEARCH_WINDOW}), INT_MAX);
+
+  // snippets are costly: only generate those of the page, in the same run
+  runQuery(windowEnd, snippetStart, withSnippets ? end : 0);
+  m_started = true;
+  m_complete = m_results.size() < windowEnd;
+}
+
+void ZimSearchResultSet::fetchSnippets(size_t start, size_t end)
+{
+  // m_mutex must be held ; [start, end) already fetched, by m_search
+  const auto first = m_results.begin() + start;
+  const auto last = m_results.begin() + end;
+  if (std::all_of(first, last, [](const ZimSearchResult& r) { return r.hasSnippet; }))
+    return;
+
+  // m_search serves the matches of its run again, without a new query
+  size_t index = 0;
+  const auto endIt = m_search->end();
+  for (auto it = m_search->begin(); it != endIt && index < end; ++it, ++index) {
+    ZimSearchResult& result = m_results[index];
+    if (index < start || result.hasSnippet)
+      continue;
+    result.snippet = it.get_snippet();
+    result.hasSnippet = true;
+  }
+}
+
+int ZimSearchResultSet::getEstimatedMatches()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  fetch(0, 0, false);
+  return m_estimatedMatches;
+}
+
+std::vector<ZimSearchResult> ZimSearchResultSet::getResults(size_t start,
+                                                            size_t count,
+                                                            bool withSnippets)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  fetch(start + count, start, withSnippets);
+  std::vector<ZimSearchResult> results;
+  if (start < m_results.size()) {
+    const size_t end = start + std::min(count, m_results.size() - start);
+    if (withSnippets)
+      fetchSnippets(start, end);
+    results.assign(m_results.begin() + start, m_results.begin() + end);
+  }
+  return results;
 }
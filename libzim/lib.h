@@ -32,29 +32,144 @@ typedef _object PyObject;
 #include <zim/blob.h>
 #include <zim/writer/item.h>
 #include <zim/writer/contentProvider.h>
+#include <zim/writer/creator.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <new>
 
-template<typename T, typename U>
-inline T* to_ptr(const U& obj)
+// Inline, default-constructible storage for libzim value types.
+// zim::Entry and zim::Item have no default constructor, which prevents
+// holding them by value in Cython objects (or their temporaries) and
+// would force a heap allocation per lookup.
+template<typename T>
+class ValueHolder
 {
-  return new T(obj);
-}
+  public:
+    ValueHolder() : m_valid(false) {}
+    ValueHolder(const T& value) : m_valid(true)
+    { new (&m_storage) T(value); }
+    ValueHolder(const ValueHolder& other) : m_valid(other.m_valid)
+    { if (m_valid) new (&m_storage) T(other.get()); }
+    ValueHolder& operator=(const ValueHolder& other)
+    {
+      if (this != &other) {
+        reset();
+        if (other.m_valid) {
+          new (&m_storage) T(other.get());
+          m_valid = true;
+        }
+      }
+      return *this;
+    }
+    ~ValueHolder() { reset(); }
+
+    bool valid() const { return m_valid; }
+    void reset()
+    {
+      if (m_valid) {
+        get().~T();
+        m_valid = false;
+      }
+    }
+
+  protected:
+    const T& get() const { return *reinterpret_cast<const T*>(&m_storage); }
+
+  private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+    bool m_valid;
+};
+
+class ZimItem : public ValueHolder<zim::Item>
+{
+  public:
+    ZimItem() {}
+    ZimItem(const zim::Item& item) : ValueHolder<zim::Item>(item) {}
+
+    std::string getTitle() const { return get().getTitle(); }
+    std::string getPath() const { return get().getPath(); }
+    std::string getMimetype() const { return get().getMimetype(); }
+    zim::Blob getData(zim::offset_type offset) const
+    { return get().getData(offset); }
+    zim::Blob getData(zim::offset_type offset, zim::size_type size) const
+    { return get().getData(offset, size); }
+    zim::size_type getSize() const { return get().getSize(); }
+    zim::entry_index_type getIndex() const { return get().getIndex(); }
+    std::pair<std::string, zim::offset_type> getDirectAccessInformation() const
+    { return get().getDirectAccessInformation(); }
+
+    // Write `size` bytes of content starting at `offset` to file descriptor
+    // `fd`. Uncompressed content is sent straight from the archive file with
+    // sendfile() where available. Returns the number of bytes written, which is
+    // less than requested if `fd` is non-blocking and would block (then
+    // `wouldBlock` is set).
+    zim::size_type sendTo(int fd, zim::offset_type offset, zim::size_type size,
+                          bool& wouldBlock) const;
+
+    // Copy up to `size` bytes of content starting at `offset` to `buffer`.
+    // Returns the number of bytes copied (0 at or past the end).
+    zim::size_type readInto(char* buffer, zim::offset_type offset, zim::size_type size) const;
+};
+
+class ZimEntry : public ValueHolder<zim::Entry>
+{
+  public:
+    ZimEntry() {}
+    ZimEntry(const zim::Entry& entry) : ValueHolder<zim::Entry>(entry) {}
 
-class ZimItem : public zim::Item
+    std::string getTitle() const { return get().getTitle(); }
+    std::string getPath() const { return get().getPath(); }
+    bool isRedirect() const { return get().isRedirect(); }
+    zim::entry_index_type getIndex() const { return get().getIndex(); }
+    ZimItem getItem(bool follow) const
+    { return ZimItem(get().getItem(follow)); }
+    ZimItem getRedirect() const
+    { return ZimItem(get().getRedirect()); }
+    ZimEntry getRedirectEntry() const
+    { return ZimEntry(get().getRedirectEntry()); }
+};
+
+// Iterates over all entries of an archive in a given order, handing them out
+// by chunks so callers do not have to cross the Python/C++ boundary per entry.
+class ZimEntryIterator
 {
   public:
-    ZimItem(const zim::Item& item) : zim::Item(item) {}
+    virtual ~ZimEntryIterator() = default;
+
+    // Append up to `count` next entries to `out` ; returns how many were added
+    // (0 once exhausted)
+    virtual size_t fill(std::vector<ZimEntry>& out, size_t count) = 0;
 };
 
-class ZimEntry : public zim::Entry
+template<zim::EntryOrder order>
+class ZimEntryRangeIterator : public ZimEntryIterator
 {
   public:
-    ZimEntry(const zim::Entry& entry) : zim::Entry(entry) {}
-    ZimItem* getItem(bool follow) const
-    { return to_ptr<ZimItem>(zim::Entry::getItem(follow)); }
-    ZimEntry* getRedirectEntry() const
-    { return to_ptr<ZimEntry>(zim::Entry::getRedirectEntry()); }
+    explicit ZimEntryRangeIterator(const zim::Archive::EntryRange<order>& range)
+      : m_current(range.begin()), m_end(range.end()) {}
+
+    virtual size_t fill(std::vector<ZimEntry>& out, size_t count)
+    {
+      size_t added = 0;
+      for (; added < count && m_current != m_end; ++m_current, ++added)
+        out.push_back(ZimEntry(*m_current));
+      return added;
+    }
+
+  private:
+    zim::Archive::iterator<order> m_current;
+    zim::Archive::iterator<order> m_end;
 };
 
 class ZimSearch : public zim::Search
@@ -62,6 +177,7 @@ class ZimSearch : public zim::Search
   public:
     ZimSearch() : zim::Search(std::vector<zim::Archive>{}) {};
     ZimSearch(zim::Archive& archive) : zim::Search(archive) {};
+    ZimSearch(const std::vector<zim::Archive>& archives) : zim::Search(archives) {};
     ZimSearch(const Search& search) : zim::Search(search) {};
 };
 
@@ -71,49 +187,398 @@ class ZimArchive : public zim::Archive
     ZimArchive(const std::string& filename) : zim::Archive(filename) {};
     ZimArchive(const zim::Archive& archive) : zim::Archive(archive) {};
 
-    ZimEntry* getEntryByPath(zim::entry_index_type idx) const
-    { return to_ptr<ZimEntry>(zim::Archive::getEntryByPath(idx)); }
-    ZimEntry* getEntryByPath(const std::string& path) const
-    { return to_ptr<ZimEntry>(zim::Archive::getEntryByPath(path)); }
-    ZimEntry* getEntryByTitle(zim::entry_index_type idx) const
-    { return to_ptr<ZimEntry>(zim::Archive::getEntryByTitle(idx)); }
-    ZimEntry* getEntryByTitle(const std::string& title) const
-    { return to_ptr<ZimEntry>(zim::Archive::getEntryByTitle(title)); }
-    ZimEntry* getMainEntry() const
-    { return to_ptr<ZimEntry>(zim::Archive::getMainEntry()); }
-    ZimEntry* getFaviconEntry() const
-    { return to_ptr<ZimEntry>(zim::Archive::getFaviconEntry()); }
+    ZimEntry getEntryByPath(zim::entry_index_type idx) const
+    { return ZimEntry(zim::Archive::getEntryByPath(idx)); }
+    ZimEntry getEntryByPath(const std::string& path) const
+    { return ZimEntry(zim::Archive::getEntryByPath(path)); }
+    ZimEntry getEntryByTitle(zim::entry_index_type idx) const
+    { return ZimEntry(zim::Archive::getEntryByTitle(idx)); }
+    ZimEntry getEntryByTitle(const std::string& title) const
+    { return ZimEntry(zim::Archive::getEntryByTitle(title)); }
+    ZimEntry getMainEntry() const
+    { return ZimEntry(zim::Archive::getMainEntry()); }
+    ZimEntry getFaviconEntry() const
+    { return ZimEntry(zim::Archive::getFaviconEntry()); }
+
+    ZimEntryIterator* iterByPath() const
+    { return new ZimEntryRangeIterator<zim::EntryOrder::pathOrder>(zim::Archive::iterByPath()); }
+    ZimEntryIterator* iterByTitle() const
+    { return new ZimEntryRangeIterator<zim::EntryOrder::titleOrder>(zim::Archive::iterByTitle()); }
+    ZimEntryIterator* iterEfficient() const
+    { return new ZimEntryRangeIterator<zim::EntryOrder::efficientOrder>(zim::Archive::iterEfficient()); }
     std::string getUuid() const
     { zim::Uuid uuid = zim::Archive::getUuid();
       std::string uuids(uuid.data, uuid.size()); return uuids; }
+    ZimItem getMetadataItem(const std::string& name) const
+    { return ZimItem(zim::Archive::getMetadataItem(name)); }
+
+    // Content of the named metadata (all if names is empty), read at once
+    // and without copy. Missing names are skipped.
+    std::vector<std::pair<std::string, zim::Blob>>
+    getMetadataSnapshot(const std::vector<std::string>& names) const;
+
+    // Batch lookups. Output arrays must have one slot per requested
+    // path/index ; unset slots of missing entries are left untouched.
+    void getEntriesByPath(const std::vector<std::string>& paths,
+                          zim::entry_index_type* indexes,
+                          unsigned char* redirects,
+                          unsigned char* missing) const;
+    void getEntriesByIndex(const std::vector<zim::entry_index_type>& idxs,
+                           zim::entry_index_type* indexes,
+                           unsigned char* redirects,
+                           unsigned char* missing) const;
+};
+
+// Open an archive, shared with all other openers using the same key.
+// An empty key opens a new (unshared) archive.
+// Shared archives share libzim's cluster and dirent caches.
+// Non-zero cache sizes (number of clusters/dirents) replace libzim's
+// defaults (ZIM_CLUSTERCACHE/ZIM_DIRENTCACHE env vars, read on open).
+// Those are set in the process environment for the open: other opens
+// wait meanwhile, opens with default sizes run in parallel.
+std::shared_ptr<ZimArchive> openArchive(const std::string& filename,
+                                        const std::string& key,
+                                        size_t clusterCacheSize = 0,
+                                        size_t direntCacheSize = 0);
+
+// Hint the kernel to read the index parts (pointer lists, mime types)
+// of an archive in the page cache, shared by all processes.
+// Returns false if file is not a (single part) ZIM file.
+bool prefaultArchive(const std::string& filename);
+
+// Mime types of an archive, as listed in its header: an item's mime type
+// index (in libzim's dirent) is its position in this list.
+std::vector<std::string> readMimeTypes(const std::string& filename);
+
+// Result of a ZimTaskPool task
+struct ZimTaskResult
+{
+  uint64_t id;
+  ZimEntry entry;
+  ZimItem item;
+  zim::Blob content;
+  bool withItem;
+  bool notFound;
+  std::string error;
+};
+
+// Native threads running reader tasks (lookup, decompression) without
+// the GIL. Completion is signaled on a pipe (getFd() is readable while
+// results are pending) so that event loops can collect them.
+class ZimTaskPool
+{
+  public:
+    explicit ZimTaskPool(size_t nbThreads);
+    // Pending tasks are dropped (without result)
+    ~ZimTaskPool();
+
+    int getFd() const { return m_pipe[0]; }
+    // Entry at path, and its item with content loaded if withItem
+    void getEntryByPath(uint64_t id,
+                        const std::shared_ptr<ZimArchive>& archive,
+                        const std::string& path,
+                        bool withItem);
+    // Completed results, in completion order
+    std::vector<ZimTaskResult> popResults();
+
+  private:
+    struct Task
+    {
+      uint64_t id;
+      std::shared_ptr<ZimArchive> archive;
+      std::string path;
+      bool withItem;
+    };
+
+    void run();
+    void pushResult(ZimTaskResult&& result);
+
+    std::mutex m_tasksMutex;
+    std::condition_variable m_tasksCond;
+    std::deque<Task> m_tasks;
+    bool m_stop;
+
+    std::mutex m_resultsMutex;
+    std::vector<ZimTaskResult> m_results;
+
+    int m_pipe[2];
+    std::vector<std::thread> m_threads;
+};
+
+// Warm libzim's caches for entries expected to be read soon, on a
+// background thread: clusters of compressed items are decompressed (in
+// libzim's cluster cache) and, if adviseFile, the kernel is asked to read
+// ahead the content of uncompressed items.
+// A hint only: paths are dropped while too many are pending. Returns the
+// number of paths queued.
+size_t prefetchEntries(const std::shared_ptr<ZimArchive>& archive,
+                       const std::vector<std::string>& paths,
+                       bool adviseFile);
+
+// Verifies the checksum of an archive (as zim::Archive::check()) on
+// native threads: one reads the file parts ahead while another hashes.
+// Progress can be polled while running and the check cancelled.
+class ZimChecker
+{
+  public:
+    enum Status { NOT_STARTED, RUNNING, VALID, INVALID, NO_CHECKSUM, CANCELLED, FAILED };
+
+    // parts: the file, or all parts (.zimaa, .zimab...) of a split archive
+    explicit ZimChecker(const std::vector<std::string>& parts);
+    ~ZimChecker();
+
+    void start();
+    void cancel();
+    // Wait for the end of the check, up to timeout seconds (forever if < 0).
+    // Returns whether it has ended.
+    bool wait(double timeout);
+
+    uint64_t getProcessed() const { return m_processed; }
+    uint64_t getTotal() const { return m_total; }
+    Status getStatus() const;
+    std::string getError() const;
+
+  private:
+    void run();
+    Status verify();
+
+    const std::vector<std::string> m_parts;
+    std::atomic<uint64_t> m_processed;
+    std::atomic<uint64_t> m_total;
+    std::atomic<bool> m_cancelled;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ended;
+    Status m_status;
+    std::string m_error;
+    std::thread m_thread;
 };
 
+// Archive properties read straight from its header and a few dirents,
+// without opening it with libzim (see readZimHeaders)
+struct ZimHeaderInfo
+{
+  std::string error;  // set if the file could not be read
+  std::string uuid;   // 16 raw bytes
+  uint16_t majorVersion = 0;
+  uint16_t minorVersion = 0;
+  uint32_t entryCount = 0;
+  uint32_t clusterCount = 0;
+  uint64_t size = 0;
+  bool hasMainEntry = false;
+  bool hasChecksum = false;
+  bool hasFulltextIndex = false;
+  std::vector<std::string> metadataKeys;
+  // requested metadata found in the archive
+  std::vector<std::pair<std::string, std::string>> metadata;
+};
+
+// Read the headers of several archives (each given by its parts) on up to
+// nbThreads threads (0: one per core), in input order.
+// Metadata values in uncompressed clusters are read directly ; those in
+// compressed clusters need libzim: archives holding any are also opened
+// with libzim to read them.
+std::vector<ZimHeaderInfo> readZimHeaders(const std::vector<std::vector<std::string>>& archives,
+                                          const std::vector<std::string>& metadataNames,
+                                          size_t nbThreads);
 
+// A search result, copied out of the Xapian results
+struct ZimSearchResult
+{
+  std::string path;
+  std::string title;
+  int score;
+  // index of the result's archive, in the archives of the result set
+  size_t archiveIndex;
+  // snippets are only generated when requested (reads the content)
+  bool hasSnippet;
+  std::string snippet;
+};
+
+// All the runs of a single query, on one or several archives (results of
+// all archives are merged and ranked together).
+// Results are kept between calls: pages are served from the results
+// fetched so far and only a page past those runs the query again, for a
+// window at least twice as large. Estimate comes from the same runs.
+// The zim::Search of the last run is kept with its matches: the estimate
+// and snippets of fetched results are read from it without a new query.
+// Safe to use from several threads.
+class ZimSearchResultSet
+{
+  public:
+    ZimSearchResultSet(const std::vector<ZimArchive>& archives,
+                       const std::string& query,
+                       bool suggestionMode);
+
+    int getEstimatedMatches();
+    // Results [start, start+count), less if there are not enough results
+    std::vector<ZimSearchResult> getResults(size_t start, size_t count,
+                                            bool withSnippets = false);
+
+  private:
+    // Fetch results up to `end`, with snippets for [snippetStart, end)
+    void fetch(size_t end, size_t snippetStart, bool withSnippets);
+    void fetchSnippets(size_t start, size_t end);
+    // Run the query for results [0, end) in a new m_search, generating
+    // snippets of new results in [snippetStart, snippetEnd)
+    void runQuery(size_t end, size_t snippetStart, size_t snippetEnd);
+
+    // archives actually searched and their index in constructor's archives
+    std::vector<zim::Archive> m_archives;
+    std::vector<size_t> m_archiveIndexes;
+    const std::string m_query;
+    const bool m_suggestionMode;
+
+    std::mutex m_mutex;
+    // search of the last run, covering all of m_results. zim::Search fixes
+    // its range on first begin() and then serves the same matches.
+    std::unique_ptr<ZimSearch> m_search;
+    std::vector<ZimSearchResult> m_results;
+    int m_estimatedMatches;
+    bool m_started;
+    bool m_complete;
+};
+
+
+
+// Python methods called by the writer wrappers.
+// Order must match `_method_names` in wrapper.pyx
+enum PyMethod {
+  PY_GET_PATH,
+  PY_GET_TITLE,
+  PY_GET_MIMETYPE,
+  PY_GET_CONTENTPROVIDER,
+  PY_GET_SIZE,
+  PY_FEED,
+  PY_METHOD_COUNT
+};
+
+// Release the Python references held by wrappers destroyed without the
+// GIL (libzim destroys items and providers on its worker threads).
+// Those are queued (lock-free) and released by the next call to
+// releaseDeferredReferences() ; must be called with the GIL held.
+// A pending call (Py_AddPendingCall) also releases them once the
+// interpreter gets to it, so none is left if there is no such call.
+void releaseDeferredReferences();
+
+// Values of CreatorStats at a given time
+struct CreatorStatsSnapshot
+{
+  uint64_t itemsAdded;
+  uint64_t addItemNs;
+  uint64_t callbackCalls;
+  uint64_t callbackNs;
+  uint64_t gilWaitNs;
+  uint64_t bytesIn;
+};
+
+// Counters of a Creator, updated from any thread
+struct CreatorStats
+{
+  // items added, time spent in zim::writer::Creator::addItem
+  std::atomic<uint64_t> itemsAdded{0};
+  std::atomic<uint64_t> addItemNs{0};
+  // calls into Python (from libzim threads or not) and time spent
+  // waiting for the GIL before them
+  std::atomic<uint64_t> callbackCalls{0};
+  std::atomic<uint64_t> callbackNs{0};
+  std::atomic<uint64_t> gilWaitNs{0};
+  // content bytes of items
+  std::atomic<uint64_t> bytesIn{0};
+
+  void addBytesIn(uint64_t size) { bytesIn += size; }
+  CreatorStatsSnapshot snapshot() const;
+};
+
+// Values of CreatorDedup at a given time
+struct CreatorDedupSnapshot
+{
+  uint64_t itemsHashed;
+  uint64_t duplicates;
+  uint64_t bytesSaved;
+};
+
+// Content-hash deduplication of the items added to a creator.
+// Content of items up to maxSize bytes is read and hashed when added ;
+// an item with the same content and mimetype as a previous one is added as
+// a redirection to it instead of being compressed and written again.
+class CreatorDedup
+{
+  public:
+    explicit CreatorDedup(zim::size_type maxSize) : m_maxSize(maxSize) {};
+
+    void addItem(zim::writer::Creator& creator,
+                 const std::shared_ptr<zim::writer::Item>& item,
+                 CreatorStats& stats);
+    CreatorDedupSnapshot snapshot() const;
+
+  private:
+    struct Key
+    {
+      uint64_t hash1;
+      uint64_t hash2;
+      zim::size_type size;
+      std::string mimetype;
+
+      bool operator==(const Key& other) const {
+        return hash1 == other.hash1 && hash2 == other.hash2
+            && size == other.size && mimetype == other.mimetype;
+      }
+    };
+    struct KeyHash
+    {
+      size_t operator()(const Key& key) const { return key.hash1; }
+    };
+
+    const zim::size_type m_maxSize;
+    // path of first item added for every content
+    std::unordered_map<Key, std::string, KeyHash> m_paths;
+    std::mutex m_mutex;
+    std::atomic<uint64_t> m_itemsHashed{0};
+    std::atomic<uint64_t> m_duplicates{0};
+    std::atomic<uint64_t> m_bytesSaved{0};
+};
+
+// Add item to creator, accounting it in stats.
+// Duplicated content is added as redirections if dedup is not null.
+void addItem(zim::writer::Creator& creator,
+             const std::shared_ptr<zim::writer::Item>& item,
+             CreatorStats& stats,
+             CreatorDedup* dedup = nullptr);
 
 class ObjWrapper
 {
   public:
-    ObjWrapper(PyObject* obj);
+    ObjWrapper(PyObject* obj, std::shared_ptr<CreatorStats> stats = nullptr);
     virtual ~ObjWrapper();
 
   protected:
     PyObject* m_obj;
+    // Bound methods of m_obj, looked up (with the GIL) on first call only
+    mutable PyObject* m_methods[PY_METHOD_COUNT];
+    // Where to account calls into Python, if set
+    std::shared_ptr<CreatorStats> m_stats;
 
-    std::string callCythonReturnString(std::string) const;
-    uint64_t callCythonReturnInt(std::string) const;
+    void setStats(std::shared_ptr<CreatorStats> stats) { m_stats = stats; }
+
+    std::string callCythonReturnString(PyMethod method) const;
+    uint64_t callCythonReturnInt(PyMethod method) const;
 };
 
 class WriterItemWrapper : public zim::writer::Item, private ObjWrapper
 {
   public:
-    WriterItemWrapper(PyObject *obj) : ObjWrapper(obj) {};
+    WriterItemWrapper(PyObject *obj, std::shared_ptr<CreatorStats> stats = nullptr)
+      : ObjWrapper(obj, stats), m_contentCounted(false) {};
     virtual std::string getPath() const;
     virtual std::string getTitle() const;
     virtual std::string getMimeType() const;
     virtual std::unique_ptr<zim::writer::ContentProvider> getContentProvider() const;
 
   private:
-    std::unique_ptr<zim::writer::ContentProvider> callCythonReturnContentProvider(std::string) const;
+    std::unique_ptr<zim::writer::ContentProvider> callCythonReturnContentProvider(PyMethod method) const;
+    // content is read more than once (indexing): only count first provider
+    mutable std::atomic<bool> m_contentCounted;
 };
 
 class ContentProviderWrapper : public zim::writer::ContentProvider, private ObjWrapper
@@ -122,8 +587,122 @@ class ContentProviderWrapper : public zim::writer::ContentProvider, private ObjW
     ContentProviderWrapper(PyObject *obj) : ObjWrapper(obj) {};
     virtual zim::size_type getSize() const;
     virtual zim::Blob feed();
+    using ObjWrapper::setStats;
+  private:
+    zim::Blob callCythonReturnBlob(PyMethod method) const;
+};
+
+// Native provider for a file's content, used by StaticItem and in place of
+// plain `writer.FileProvider` Python providers. Content is fed straight from
+// a read-only mmap of the file (pread() into a buffer if mmap is not possible).
+class FileContentProvider : public zim::writer::ContentProvider
+{
+  public:
+    FileContentProvider(const std::string& filepath, zim::size_type size);
+    virtual ~FileContentProvider();
+    virtual zim::size_type getSize() const { return m_size; }
+    virtual zim::Blob feed();
+
+  private:
+    void open();
+
+    std::string m_filepath;
+    zim::size_type m_size;
+    zim::size_type m_offset;
+    int m_fd;
+    char* m_map;
+    std::unique_ptr<char[]> m_buffer;
+};
+
+// Bounded queue of items added to a creator by a background thread, so
+// producers do not wait on each addItem call.
+// Errors raised by addItem are reported by the next push() or drain().
+class CreatorItemQueue
+{
+  public:
+    CreatorItemQueue(zim::writer::Creator& creator, size_t maxSize, CreatorStats& stats,
+                     CreatorDedup* dedup = nullptr);
+    ~CreatorItemQueue();
+
+    // Blocks while queue is full.
+    void push(const std::shared_ptr<zim::writer::Item>& item);
+    // Wait until all pushed items have been added to the creator.
+    void drain();
+    size_t size() const;
+
+  private:
+    void run();
+    void rethrowError();
+
+    zim::writer::Creator& m_creator;
+    CreatorStats& m_stats;
+    CreatorDedup* m_dedup;
+    const size_t m_maxSize;
+    std::deque<std::shared_ptr<zim::writer::Item>> m_queue;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_pushed;
+    std::condition_variable m_popped;
+    bool m_busy;
+    bool m_stop;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+};
+
+/*
+ Native writer items/providers. All their data is given at construction
+ (with the GIL) so they never call back into Python once added to a Creator.
+*/
+
+// Adds the size of content fed by another provider to stats
+class CountingContentProvider : public zim::writer::ContentProvider
+{
+  public:
+    CountingContentProvider(std::unique_ptr<zim::writer::ContentProvider> provider,
+                            std::shared_ptr<CreatorStats> stats)
+      : m_provider(std::move(provider)), m_stats(stats) {};
+    virtual zim::size_type getSize() const { return m_provider->getSize(); }
+    virtual zim::Blob feed();
+
+  private:
+    std::unique_ptr<zim::writer::ContentProvider> m_provider;
+    std::shared_ptr<CreatorStats> m_stats;
+};
+
+class StringContentProvider : public zim::writer::ContentProvider
+{
+  public:
+    explicit StringContentProvider(const std::shared_ptr<const std::string>& content)
+      : m_content(content), m_fed(false) {};
+    virtual zim::size_type getSize() const { return m_content->size(); }
+    virtual zim::Blob feed();
+
+  private:
+    std::shared_ptr<const std::string> m_content;
+    bool m_fed;
+};
+
+class StaticWriterItem : public zim::writer::Item
+{
+  public:
+    // `content` is the item's content or, if `isFile`, the path of a file
+    // holding it (read when the item is written).
+    StaticWriterItem(const std::string& path, const std::string& title,
+                     const std::string& mimetype, const std::string& content,
+                     bool isFile);
+    virtual std::string getPath() const { return m_path; }
+    virtual std::string getTitle() const { return m_title; }
+    virtual std::string getMimeType() const { return m_mimetype; }
+    virtual std::unique_ptr<zim::writer::ContentProvider> getContentProvider() const;
+
+    zim::size_type getSize() const { return m_size; }
+
   private:
-    zim::Blob callCythonReturnBlob(std::string) const;
+    std::string m_path;
+    std::string m_title;
+    std::string m_mimetype;
+    std::shared_ptr<const std::string> m_content;
+    std::string m_filepath;
+    zim::size_type m_size;
 };
 
 #endif // !libzim_LIB_H
@@ -3,6 +3,10 @@
     - Archive to open and read ZIM files
     - `Archive` gives access to all `Entry`
     - `Entry` gives access to `Item` (content)
+    - `Item.open()` reads content as a file (`ItemReader`)
+    - `Checker` to verify an archive checksum in background, with progress
+    - `ReaderStats` counters of lookups and reads (`Archive.enable_stats()`)
+    - `read_headers()` to scan many ZIM files quickly, without opening them
 
     Usage:
 
@@ -13,7 +17,27 @@
     """
 
 # flake8: noqa
-from .wrapper import PyArchive as Archive, Entry, Item
+from .wrapper import (
+    PyArchive as Archive,
+    ArchiveHeader,
+    Checker,
+    Entry,
+    Item,
+    ItemReader,
+    ReaderStats,
+    read_header,
+    read_headers,
+)
 
 
-__all__ = ["Archive", "Entry", "Item"]
+__all__ = [
+    "Archive",
+    "ArchiveHeader",
+    "Checker",
+    "Entry",
+    "Item",
+    "ItemReader",
+    "ReaderStats",
+    "read_header",
+    "read_headers",
+]
@@ -0,0 +1,21 @@
+""" libzim search module
+
+    - Searcher to run full-text searches and title suggestions on archives
+    - `Search` keeps the results of a query, paged via `get_results()`
+      or `get_records()` (path, title, score and snippet of results)
+
+    Usage:
+
+    archive = Archive(fpath)
+    searcher = Searcher(archive)
+    search = searcher.search(Query().set_query("lorem ipsum"))
+    print(f"{search.get_estimated_matches()} matches")
+    for path in search.get_results(0, 10):
+        print(archive.get_entry_by_path(path).title)
+    """
+
+# flake8: noqa
+from .wrapper import Query, Searcher, Search, SearchResultSet, SearchRecord
+
+
+__all__ = ["Query", "Searcher", "Search", "SearchResultSet", "SearchRecord"]
@@ -19,10 +19,11 @@
 
 from cpython.ref cimport PyObject
 
-from libc.stdint cimport uint32_t, uint64_t
+from libc.stdint cimport uint16_t, uint32_t, uint64_t
 from libcpp cimport bool
 from libcpp.memory cimport shared_ptr, unique_ptr
 from libcpp.string cimport string
+from libcpp.utility cimport pair
 from libcpp.vector cimport vector
 
 
@@ -71,31 +72,83 @@ cdef extern from "zim/writer/creator.h" namespace "zim::writer":
         void setMainPath(string mainPath)
         void setFaviconPath(string faviconPath)
 
+# Creator counters, updated (atomically) from any thread
+cdef extern from "lib.h" nogil:
+    cdef cppclass CreatorStatsSnapshot:
+        uint64_t itemsAdded
+        uint64_t addItemNs
+        uint64_t callbackCalls
+        uint64_t callbackNs
+        uint64_t gilWaitNs
+        uint64_t bytesIn
+
+    cdef cppclass CreatorStats:
+        void addBytesIn(uint64_t size)
+        CreatorStatsSnapshot snapshot()
+
+    cdef cppclass CreatorDedupSnapshot:
+        uint64_t itemsHashed
+        uint64_t duplicates
+        uint64_t bytesSaved
+
+    cdef cppclass CreatorDedup:
+        CreatorDedup(size_type maxSize)
+        CreatorDedupSnapshot snapshot()
+
+    void addItem(ZimCreator& creator, shared_ptr[WriterItem] item,
+                 CreatorStats& stats, CreatorDedup* dedup) except +
+
 cdef extern from "lib.h":
     # The only thing we need to know here is how to create the Wrapper.
     # Other (cpp) methods must exists and they will be called,
     # but we don't care about them here.
     cdef cppclass ContentProviderWrapper(ContentProvider):
         ContentProviderWrapper(PyObject* obj) except +
+    cdef cppclass FileContentProvider(ContentProvider):
+        FileContentProvider(string filepath, size_type size) except +
     cdef cppclass WriterItemWrapper:
-        WriterItemWrapper(PyObject* obj) except +
+        WriterItemWrapper(PyObject* obj, shared_ptr[CreatorStats] stats) except +
+    # Release references of wrappers destroyed by libzim threads (needs GIL)
+    void releaseDeferredReferences()
 
-cdef extern from "lib.h":
+    # Native item, never calling back into Python
+    cdef cppclass StaticWriterItem(WriterItem):
+        StaticWriterItem(string path, string title, string mimetype,
+                         string content, bint isFile) except +
+        string getPath()
+        string getTitle()
+        string getMimeType()
+        size_type getSize()
+
+# Items pushed to the queue are added to the creator by a background thread
+cdef extern from "lib.h" nogil:
+    cdef cppclass CreatorItemQueue:
+        CreatorItemQueue(ZimCreator& creator, size_t maxSize,
+                         CreatorStats& stats, CreatorDedup* dedup) except +
+        void push(shared_ptr[WriterItem] item) except +
+        void drain() except +
+        size_t size()
+
+# Reader-side calls may block on I/O and decompression (cluster reads, Xapian
+# queries, checksum); they are declared nogil so callers can release the GIL.
+cdef extern from "lib.h" nogil:
+    # Entry and Item wrappers hold libzim values inline (no heap allocation)
     cdef cppclass ZimEntry:
+        ZimEntry()
         string getTitle()
         string getPath() except +
 
         bint isRedirect()
-        ZimItem* getItem(bint follow) except +
-        ZimItem* getRedirect() except +
-        ZimEntry* getRedirectEntry() except +
+        ZimItem getItem(bint follow) except +
+        ZimItem getRedirect() except +
+        ZimEntry getRedirectEntry() except +
 
         int getIndex() except +
 
 
-cdef extern from "lib.h":
+cdef extern from "lib.h" nogil:
     cdef cppclass ZimItem:
-        ZimItem __enter__()
+        ZimItem()
         string getTitle() except +
         string getPath() except +
         string getMimetype() except +
@@ -103,11 +156,19 @@ cdef extern from "lib.h":
         const Blob getData(offset_type offset) except +
         const Blob getData(offset_type offset, size_type size) except +
         size_type  getSize() except +
+        pair[string, offset_type] getDirectAccessInformation() except +
+        size_type sendTo(int fd, offset_type offset, size_type size, bool& wouldBlock) except +
+        size_type readInto(char* buffer, offset_type offset, size_type size) except +
 
         int getIndex() except +
 
 
-cdef extern from "zim/search_iterator.h" namespace "zim":
+cdef extern from "lib.h" nogil:
+    cdef cppclass ZimEntryIterator:
+        size_t fill(vector[ZimEntry]& out, size_t count) except +
+
+
+cdef extern from "zim/search_iterator.h" namespace "zim" nogil:
     cdef cppclass search_iterator:
         search_iterator()
         search_iterator operator++()
@@ -117,7 +178,7 @@ cdef extern from "zim/search_iterator.h" namespace "zim":
         string get_title()
 
 
-cdef extern from "lib.h":
+cdef extern from "lib.h" nogil:
     cdef cppclass ZimSearch:
         ZimSearch()
         ZimSearch(const ZimArchive zimfile)
@@ -125,26 +186,35 @@ cdef extern from "lib.h":
         void set_suggestion_mode(bint suggestion)
         void set_query(string query)
         void set_range(int, int)
-        search_iterator begin()
-        search_iterator end()
-        int get_matches_estimated()
+        search_iterator begin() except +
+        search_iterator end() except +
+        int get_matches_estimated() except +
 
 
-cdef extern from "lib.h":
+cdef extern from "lib.h" nogil:
     cdef cppclass ZimArchive:
         ZimArchive(string filename) except +
 
         int getFilesize() except +
 
-        ZimEntry* getEntryByPath(string path) except +
-        ZimEntry* getEntryByPath(entry_index_type idx) except +
-        ZimEntry* getEntryByTitle(string title) except +
+        ZimEntry getEntryByPath(string path) except +
+        ZimEntry getEntryByPath(entry_index_type idx) except +
+        ZimEntry getEntryByTitle(string title) except +
+        void getEntriesByPath(vector[string] paths, entry_index_type* indexes,
+                              unsigned char* redirects, unsigned char* missing) except +
+        void getEntriesByIndex(vector[entry_index_type] idxs, entry_index_type* indexes,
+                               unsigned char* redirects, unsigned char* missing) except +
 
         string getMetadata(string name) except +
         vector[string] getMetadataKeys() except +
+        ZimItem getMetadataItem(string name) except +
+        vector[pair[string, Blob]] getMetadataSnapshot(vector[string] names) except +
 
-        ZimEntry* getMainEntry() except +
-        ZimEntry* getFaviconEntry() except +
+        ZimEntry getMainEntry() except +
+        ZimEntry getFaviconEntry() except +
+        ZimEntryIterator* iterByPath() except +
+        ZimEntryIterator* iterByTitle() except +
+        ZimEntryIterator* iterEfficient() except +
         size_type getEntryCount() except +
 
         string getChecksum() except +
@@ -161,3 +231,92 @@ cdef extern from "lib.h":
         bool hasTitleIndex() except +
         bool hasChecksum() except +
         bool check() except +
+
+
+cdef extern from "lib.h" nogil:
+    # Archives opened with the same (non empty) key share one ZimArchive
+    shared_ptr[ZimArchive] openArchive(string filename, string key,
+                                       size_t clusterCacheSize,
+                                       size_t direntCacheSize) except +
+    bint prefaultArchive(string filename)
+    vector[string] readMimeTypes(string filename) except +
+    size_t prefetchEntries(shared_ptr[ZimArchive] archive, vector[string] paths,
+                           bint adviseFile) except +
+
+
+cdef extern from "lib.h" nogil:
+    cdef cppclass ZimTaskResult:
+        uint64_t id
+        ZimEntry entry
+        ZimItem item
+        Blob content
+        bint withItem
+        bint notFound
+        string error
+
+    cdef cppclass ZimTaskPool:
+        ZimTaskPool(size_t nbThreads) except +
+        int getFd()
+        void getEntryByPath(uint64_t id, shared_ptr[ZimArchive] archive,
+                            string path, bint withItem) except +
+        vector[ZimTaskResult] popResults()
+
+
+cdef extern from "lib.h" nogil:
+    ctypedef enum CheckStatus "ZimChecker::Status":
+        CHECK_NOT_STARTED "ZimChecker::NOT_STARTED"
+        CHECK_RUNNING "ZimChecker::RUNNING"
+        CHECK_VALID "ZimChecker::VALID"
+        CHECK_INVALID "ZimChecker::INVALID"
+        CHECK_NO_CHECKSUM "ZimChecker::NO_CHECKSUM"
+        CHECK_CANCELLED "ZimChecker::CANCELLED"
+        CHECK_FAILED "ZimChecker::FAILED"
+
+
+cdef extern from "lib.h" nogil:
+    cdef cppclass ZimChecker:
+        ZimChecker(vector[string] parts) except +
+        void start() except +
+        void cancel()
+        bint wait(double timeout)
+        uint64_t getProcessed()
+        uint64_t getTotal()
+        CheckStatus getStatus()
+        string getError()
+
+
+cdef extern from "lib.h" nogil:
+    cdef cppclass ZimHeaderInfo:
+        string error
+        string uuid
+        uint16_t majorVersion
+        uint16_t minorVersion
+        uint32_t entryCount
+        uint32_t clusterCount
+        uint64_t size
+        bint hasMainEntry
+        bint hasChecksum
+        bint hasFulltextIndex
+        vector[string] metadataKeys
+        vector[pair[string, string]] metadata
+
+    vector[ZimHeaderInfo] readZimHeaders(vector[vector[string]] archives,
+                                         vector[string] metadataNames,
+                                         size_t nbThreads) except +
+
+
+cdef extern from "lib.h" nogil:
+    cdef cppclass ZimSearchResult:
+        string path
+        string title
+        int score
+        size_t archiveIndex
+        bint hasSnippet
+        string snippet
+
+    cdef cppclass ZimSearchResultSet:
+        ZimSearchResultSet(vector[ZimArchive] archives, string query,
+                           bint suggestionMode) except +
+        int getEstimatedMatches() except +
+        vector[ZimSearchResult] getResults(size_t start, size_t count,
+                                           bint withSnippets) except +
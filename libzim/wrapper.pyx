@@ -18,24 +18,40 @@
 # along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 
+cimport cython
 cimport libzim.wrapper as wrapper
 
+import io
 import os
 import enum
+import errno
+import time
 from uuid import UUID
-from typing import Generator
-from cython.operator import dereference, preincrement
-from cpython.ref cimport PyObject
-from cpython.buffer cimport PyBUF_WRITABLE
+from typing import Any, Awaitable, Callable, Dict, Generator, Iterable, List, Optional, Tuple
+from cython.operator import dereference
+from cpython.ref cimport PyObject, Py_INCREF
+from cpython.buffer cimport PyBUF_WRITABLE, PyBUF_SIMPLE, PyObject_GetBuffer, PyBuffer_Release
+from cpython cimport array
 
 from libc.stdint cimport uint64_t
+from libc.string cimport memset
+from posix.time cimport clock_gettime, timespec, CLOCK_MONOTONIC
 from libcpp.string cimport string
+from libcpp.unordered_map cimport unordered_map
+from libcpp.utility cimport pair
+from libcpp.vector cimport vector
 from libcpp cimport bool
 from libcpp.memory cimport shared_ptr, make_shared, unique_ptr
 
+import array
+import asyncio
 import pathlib
 import datetime
+import threading
 import traceback
+import collections
+import functools
+import weakref
 
 
 #########################
@@ -43,15 +59,21 @@ import traceback
 #########################
 
 cdef class WritingBlob:
+    """ Content passed to libzim
+
+        Accepts a str (UTF-8 encoded) or any object exposing a contiguous buffer
+        (bytes, bytearray, memoryview, mmap, numpy arrays...) which is used
+        without copy. The buffer stays locked as long as the blob exists. """
     cdef wrapper.Blob* c_blob
-    cdef bytes ref_content
+    cdef Py_buffer view
+    cdef bint has_view
 
     def __cinit__(self, content):
         if isinstance(content, str):
-            self.ref_content = content.encode('UTF-8')
-        else:
-            self.ref_content = content
-        self.c_blob = new wrapper.Blob(<char *> self.ref_content, len(self.ref_content))
+            content = content.encode('UTF-8')
+        PyObject_GetBuffer(content, &self.view, PyBUF_SIMPLE)
+        self.has_view = True
+        self.c_blob = new wrapper.Blob(<char *> self.view.buf, self.view.len)
 
     def size(self):
         return self.c_blob.size()
@@ -59,6 +81,8 @@ cdef class WritingBlob:
     def __dealloc__(self):
         if self.c_blob != NULL:
             del self.c_blob
+        if self.has_view:
+            PyBuffer_Release(&self.view)
 
 cdef Py_ssize_t itemsize = 1
 
@@ -66,6 +90,7 @@ cdef class ReadingBlob:
     cdef wrapper.Blob c_blob
     cdef Py_ssize_t size
     cdef int view_count
+    cdef ReaderStats stats
 
     cdef __setup(self, wrapper.Blob blob):
         """Assigns an internal pointer to the wrapped C++ article object.
@@ -100,6 +125,8 @@ cdef class ReadingBlob:
         buffer.suboffsets = NULL                # for pointer arrays only
 
         self.view_count += 1
+        if self.stats is not None:
+            self.stats.blob_bytes += self.size
 
     def __releasebuffer__(self, Py_buffer *buffer):
         self.view_count -= 1
@@ -107,24 +134,55 @@ cdef class ReadingBlob:
 
 #------- pure virtual methods --------
 
+# Python methods called from C++, indexed by PyMethod (see lib.h).
+# Cython interns these literals.
+cdef tuple _method_names = (
+    "get_path",
+    "get_title",
+    "get_mimetype",
+    "get_contentprovider",
+    "get_size",
+    "feed",
+)
+
+cdef object get_method(object obj, PyObject** methods, int method):
+    """Bound method `method` of obj, looked up once and cached in `methods`
+
+    `methods` belongs to the C++ ObjWrapper which releases the references"""
+    if methods[method] == NULL:
+        func = getattr(obj, _method_names[method])
+        Py_INCREF(func)
+        methods[method] = <PyObject*>func
+    return <object>methods[method]
+
+cdef object _python_file_provider = None
+
+cdef bint is_plain_file_provider(object provider):
+    """Whether provider is a `writer.FileProvider` (not a subclass of it)
+
+    Those only read a file: it is done natively instead of calling back."""
+    global _python_file_provider
+    if _python_file_provider is None:
+        from libzim.writer import FileProvider
+        _python_file_provider = FileProvider
+    return type(provider) is _python_file_provider
+
 cdef public api:
-    string string_cy_call_fct(object obj, string method, string *error) with gil:
-        """Lookup and execute a pure virtual method on object returning a string"""
+    string string_cy_call_fct(object obj, PyObject** methods, int method, string *error) with gil:
+        """Execute a pure virtual method on object returning a string"""
         try:
-            func = getattr(obj, method.decode('UTF-8'))
-            ret_str = func()
+            ret_str = get_method(obj, methods, method)()
             return ret_str.encode('UTF-8')
         except Exception as e:
             error[0] = traceback.format_exc().encode('UTF-8')
         return b""
 
-    wrapper.Blob blob_cy_call_fct(object obj, string method, string *error) with gil:
-        """Lookup and execute a pure virtual method on object returning a Blob"""
+    wrapper.Blob blob_cy_call_fct(object obj, PyObject** methods, int method, string *error) with gil:
+        """Execute a pure virtual method on object returning a Blob"""
         cdef WritingBlob blob
 
         try:
-            func = getattr(obj, method.decode('UTF-8'))
-            blob = func()
+            blob = get_method(obj, methods, method)()
             if blob is None:
                 raise RuntimeError("Blob is none")
             return dereference(blob.c_blob)
@@ -133,12 +191,14 @@ cdef public api:
 
         return Blob()
 
-    wrapper.ContentProvider* contentprovider_cy_call_fct(object obj, string method, string *error) with gil:
+    wrapper.ContentProvider* contentprovider_cy_call_fct(object obj, PyObject** methods, int method, string *error) with gil:
         try:
-            func = getattr(obj, method.decode('UTF-8'))
-            contentProvider = func()
+            contentProvider = get_method(obj, methods, method)()
             if not contentProvider:
                 raise RuntimeError("ContentProvider is None")
+            if is_plain_file_provider(contentProvider):
+                return new FileContentProvider(
+                    str(contentProvider.filepath).encode('UTF-8'), contentProvider.size)
             return new ContentProviderWrapper(<PyObject*>contentProvider)
         except Exception as e:
             error[0] = traceback.format_exc().encode('UTF-8')
@@ -146,26 +206,95 @@ cdef public api:
         return NULL
 
     # currently have no virtual method returning a bool (was should_index/compress)
-    # bool bool_cy_call_fct(object obj, string method, string *error) with gil:
-    #     """Lookup and execute a pure virtual method on object returning a bool"""
+    # bool bool_cy_call_fct(object obj, PyObject** methods, int method, string *error) with gil:
+    #     """Execute a pure virtual method on object returning a bool"""
     #     try:
-    #         func = getattr(obj, method.decode('UTF-8'))
-    #         return func()
+    #         return get_method(obj, methods, method)()
     #     except Exception as e:
     #         error[0] = traceback.format_exc().encode('UTF-8')
     #     return False
 
-    uint64_t int_cy_call_fct(object obj, string method, string *error) with gil:
-        """Lookup and execute a pure virtual method on object returning an int"""
+    uint64_t int_cy_call_fct(object obj, PyObject** methods, int method, string *error) with gil:
+        """Execute a pure virtual method on object returning an int"""
         try:
-            func = getattr(obj, method.decode('UTF-8'))
-            return <uint64_t>func()
+            return <uint64_t>get_method(obj, methods, method)()
         except Exception as e:
             error[0] = traceback.format_exc().encode('UTF-8')
 
         return 0
 
 
+cdef class StaticItem:
+    """ Writer Item handled entirely in C++
+
+        Path, title, mimetype and content (or path of the file holding it) are
+        copied to C++ at construction. Once added to the Creator, the item never
+        calls back into Python so libzim workers don't wait for the GIL.
+
+        Attributes
+        ----------
+        c_item : shared_ptr[WriterItem]
+            the C++ writer item, as passed to the Creator
+        *c_static : StaticWriterItem
+            pointer to the same item (owned by c_item) """
+    cdef shared_ptr[wrapper.WriterItem] c_item
+    cdef wrapper.StaticWriterItem* c_static
+
+    def __cinit__(self, str path not None, str title = "", str mimetype = "",
+                  content = None, filepath = None):
+        """ Construct an item from either its content or a file
+
+            Parameters
+            ----------
+            path : str
+                Full path of the item
+            title : str
+                Item title
+            mimetype : str
+                MIME-type of the content
+            content : Union[str, bytes]
+                Content of the item (str is UTF-8 encoded)
+            filepath : Union[str, pathlib.Path]
+                Path of a file holding the content (read when item is written).
+            Raises
+            ------
+                IOError
+                    If filepath can't be read """
+        cdef string _content
+        cdef bint is_file = filepath is not None
+        if is_file:
+            if content is not None:
+                raise ValueError("Either content or filepath must be set, not both")
+            _content = str(filepath).encode('UTF-8')
+        elif isinstance(content, str):
+            _content = content.encode('UTF-8')
+        elif content is not None:
+            _content = bytes(content)
+        self.c_static = new wrapper.StaticWriterItem(
+            path.encode('UTF-8'), title.encode('UTF-8'), mimetype.encode('UTF-8'),
+            _content, is_file)
+        self.c_item = shared_ptr[wrapper.WriterItem](self.c_static)
+
+    def get_path(self) -> str:
+        return self.c_static.getPath().decode('UTF-8')
+
+    def get_title(self) -> str:
+        return self.c_static.getTitle().decode('UTF-8')
+
+    def get_mimetype(self) -> str:
+        return self.c_static.getMimeType().decode('UTF-8')
+
+    def get_size(self) -> int:
+        """ Size of the content in bytes """
+        return self.c_static.getSize()
+
+    def __repr__(self) -> str:
+        return (
+            f"{self.__class__.__name__}(path={self.get_path()}, "
+            f"title={self.get_title()})"
+        )
+
+
 class Compression(enum.Enum):
     """ Compression algorithms available to create ZIM files """
     none = wrapper.CompressionType.zimcompNone
@@ -173,6 +302,13 @@ class Compression(enum.Enum):
     zstd = wrapper.CompressionType.zimcompZstd
 
 
+# number of items wrapped between two GIL-free runs of add_items()
+cdef size_t ADD_ITEMS_BATCH = 256
+# larger items are not deduplicated by default (their content is held in
+# memory from add_item() until libzim writes them)
+DEDUP_MAX_SIZE = 1024 * 1024
+
+
 cdef class Creator:
     """ Zim Creator
 
@@ -183,15 +319,32 @@ cdef class Creator:
         _filename: pathlib.Path
             path to create the ZIM file at
         _started : bool
-            flag if the creator has started """
+            flag if the creator has started
+        c_stats : shared_ptr[CreatorStats]
+            counters shared with the C++ items and queue
+        c_dedup : shared_ptr[CreatorDedup]
+            content hashes of added items, if `config_dedup` enabled it """
 
     cdef wrapper.ZimCreator c_creator
+    cdef wrapper.CreatorItemQueue* c_queue
+    cdef shared_ptr[wrapper.CreatorStats] c_stats
+    cdef shared_ptr[wrapper.CreatorDedup] c_dedup
+    cdef int _queue_size
     cdef object _filename
     cdef object _started
+    cdef object _compression
+    cdef double _start_time
+    cdef double _end_time
+    cdef double _finish_time
 
     def __cinit__(self, object filename: pathlib.Path, *args, **kwargs):
         self._filename = pathlib.Path(filename)
         self._started = False
+        self._queue_size = 0
+        self.c_queue = NULL
+        self.c_stats = make_shared[wrapper.CreatorStats]()
+        self._compression = Compression.zstd.name
+        self._start_time = self._end_time = self._finish_time = 0
         # fail early if destination is not writable
         parent = self._filename.expanduser().resolve().parent
         if not os.access(parent, mode=os.W_OK, effective_ids=(os.access in os.supports_effective_ids)):
@@ -216,6 +369,7 @@ cdef class Creator:
         if self._started:
             raise RuntimeError("ZimCreator started")
         self.c_creator.configCompression(comptype.value)
+        self._compression = comptype.name
         return self
 
     def config_minclustersize(self, int size) -> Creator:
@@ -247,13 +401,88 @@ cdef class Creator:
 #    def set_uuid(self, uuid) -> Creator:
 #        self.c_creator.setUuid(uuid)
 
+    def config_itemqueue(self, int size) -> Creator:
+        """ Add items from a background thread, through a queue of `size` items
+
+            `add_item()` and `add_items()` then return as soon as the item is
+            queued, letting the producer prepare the next ones.
+            Errors raised while adding a queued item are reported by a later
+            `add_item()`, `add_items()`, `add_metadata()`, `add_redirection()`
+            or on exit. 0 (default) disables the queue """
+        if self._started:
+            raise RuntimeError("ZimCreator started")
+        if size < 0:
+            raise ValueError("Queue size must be positive or 0")
+        self._queue_size = size
+        return self
+
+    def config_dedup(self, bool enabled, int max_size=DEDUP_MAX_SIZE) -> Creator:
+        """ Deduplicate items by content
+
+            Content of items up to `max_size` bytes is read and hashed when
+            added. An item with the same content and mimetype as a previously
+            added one is stored as a redirection to it instead of being
+            compressed and written again (see `stats`).
+            Duplicates are thus not indexed (full-text) on their own. """
+        if self._started:
+            raise RuntimeError("ZimCreator started")
+        if max_size < 0:
+            raise ValueError("Max size must be positive or 0")
+        if enabled:
+            self.c_dedup = make_shared[wrapper.CreatorDedup](max_size)
+        else:
+            self.c_dedup.reset()
+        return self
+
+    cdef shared_ptr[wrapper.WriterItem] _make_item(self, object item) except *:
+        if item is None:
+            raise TypeError("Cannot add None as an item")
+        if isinstance(item, StaticItem):
+            # native item, used as is
+            self.c_stats.get().addBytesIn((<StaticItem>item).c_static.getSize())
+            return (<StaticItem>item).c_item
+        # Make a shared pointer to ZimArticleWrapper from the ZimArticle object
+        return shared_ptr[wrapper.WriterItem](
+            new wrapper.WriterItemWrapper(<PyObject*>item, self.c_stats))
+
+    cdef _add_batch(self, vector[shared_ptr[wrapper.WriterItem]]& batch):
+        cdef size_t index
+        wrapper.releaseDeferredReferences()
+        with nogil:
+            if self.c_queue != NULL:
+                for index in range(batch.size()):
+                    self.c_queue.push(batch[index])
+            else:
+                for index in range(batch.size()):
+                    wrapper.addItem(self.c_creator, batch[index],
+                                    dereference(self.c_stats), self.c_dedup.get())
+
+    cdef _drain_queue(self):
+        """ wait for queued items to be added, raising pending errors """
+        if self.c_queue != NULL:
+            with nogil:
+                self.c_queue.drain()
+
+    cdef _stop_queue(self):
+        cdef wrapper.CreatorItemQueue* queue = self.c_queue
+        if queue == NULL:
+            return
+        self.c_queue = NULL
+        try:
+            with nogil:
+                queue.drain()
+        finally:
+            with nogil:
+                del queue
+
     def add_item(self, WriterItem not None):
         """ Add an item to the Creator object.
 
             Parameters
             ----------
             item : WriterItem
-                The item to add to the file
+                The item to add to the file. Either a `StaticItem` (native)
+                or any object implementing the `libzim.writer.Item` interface
             Raises
             ------
                 RuntimeError
@@ -261,15 +490,45 @@ cdef class Creator:
         if not self._started:
             raise RuntimeError("ZimCreator not started")
 
-        # Make a shared pointer to ZimArticleWrapper from the ZimArticle object
-        cdef shared_ptr[wrapper.WriterItem] item = shared_ptr[wrapper.WriterItem](
-            new wrapper.WriterItemWrapper(<PyObject*>WriterItem));
+        wrapper.releaseDeferredReferences()
+        cdef shared_ptr[wrapper.WriterItem] item = self._make_item(WriterItem)
         with nogil:
-            self.c_creator.addItem(item)
+            if self.c_queue != NULL:
+                self.c_queue.push(item)
+            else:
+                wrapper.addItem(self.c_creator, item, dereference(self.c_stats),
+                                self.c_dedup.get())
+
+    def add_items(self, items: Iterable):
+        """ Add several items to the Creator object.
+
+            Items are wrapped with the GIL held, then added in a single
+            GIL-free run for every batch of items.
+
+            Parameters
+            ----------
+            items : Iterable
+                `StaticItem` or `libzim.writer.Item` objects to add
+            Raises
+            ------
+                RuntimeError
+                    If the ZimCreator was already finalized """
+        if not self._started:
+            raise RuntimeError("ZimCreator not started")
+
+        cdef vector[shared_ptr[wrapper.WriterItem]] batch
+        batch.reserve(ADD_ITEMS_BATCH)
+        for item in items:
+            batch.push_back(self._make_item(item))
+            if batch.size() >= ADD_ITEMS_BATCH:
+                self._add_batch(batch)
+                batch.clear()
+        self._add_batch(batch)
 
     def add_metadata(self, str name, bytes content, str mimetype = "text/plain"):
         if not self._started:
             raise RuntimeError("ZimCreator not started")
+        self._drain_queue()
 
         cdef string _name = name.encode('utf8')
         cdef string _content = content
@@ -280,6 +539,7 @@ cdef class Creator:
     def add_redirection(self, str path, str title, str targetPath):
         if not self._started:
             raise RuntimeError("ZimCreator not started")
+        self._drain_queue()
 
         cdef string _path = path.encode('utf8')
         cdef string _title = title.encode('utf8')
@@ -291,60 +551,344 @@ cdef class Creator:
         cdef string _path = str(self._filename).encode('utf8')
         with nogil:
             self.c_creator.startZimCreation(_path)
+        if self._queue_size:
+            self.c_queue = new wrapper.CreatorItemQueue(
+                self.c_creator, self._queue_size, dereference(self.c_stats),
+                self.c_dedup.get())
+        self._start_time = time.monotonic()
         self._started = True
         return self
 
     def __exit__(self, exc_type, exc_val, exc_tb):
-        if True or exc_type is None:
+        cdef double finish_start
+        try:
+            self._stop_queue()
+        finally:
+            try:
+                if True or exc_type is None:
+                    finish_start = time.monotonic()
+                    with nogil:
+                        self.c_creator.finishZimCreation()
+                    self._end_time = time.monotonic()
+                    self._finish_time = self._end_time - finish_start
+            finally:
+                self._started = False
+                # wrappers dropped by libzim workers while finishing
+                wrapper.releaseDeferredReferences()
+
+    def __dealloc__(self):
+        # queue thread uses c_creator: stop it first
+        cdef wrapper.CreatorItemQueue* queue = self.c_queue
+        self.c_queue = NULL
+        if queue != NULL:
             with nogil:
-                self.c_creator.finishZimCreation()
-        self._started = False
+                del queue
+        wrapper.releaseDeferredReferences()
 
     @property
     def filename(self):
         return self._filename
 
+    @property
+    def stats(self) -> Dict[str, Any]:
+        """ Counters and timings of this creation, safe to read at any time
+
+            - items_added: items handed over to libzim so far
+            - elapsed: seconds since start (until the end once finished)
+            - items_per_second: items_added / elapsed
+            - add_item_time: seconds spent in libzim's addItem (which blocks
+              while libzim's own queues are full)
+            - callback_calls, callback_time: calls from libzim workers into
+              Python items and content providers, and seconds spent in them
+            - gil_wait_time: seconds those calls waited to acquire the GIL
+            - finish_time: seconds spent finishing the ZIM file (None before)
+            - bytes_in: content size of the items actually read or added
+            - bytes_out: size of the file being written
+            - compression: configured compression algorithm
+            - item_queue_depth: items waiting in the `config_itemqueue` queue
+            - dedup_items: items whose content was hashed (`config_dedup`)
+            - dedup_duplicates: items added as redirections to a same content
+            - dedup_bytes_saved: content size of those duplicates
+
+            libzim runs compression, indexing and writing in its own workers
+            without reporting on them: stage timings are only those measured
+            at the Python / C++ boundary. """
+        cdef wrapper.CreatorStatsSnapshot snapshot = self.c_stats.get().snapshot()
+        cdef wrapper.CreatorDedupSnapshot dedup
+        dedup.itemsHashed = dedup.duplicates = dedup.bytesSaved = 0
+        if self.c_dedup.get() != NULL:
+            dedup = self.c_dedup.get().snapshot()
+        if self._start_time:
+            elapsed = (self._end_time or time.monotonic()) - self._start_time
+        else:
+            elapsed = 0.0
+        bytes_out = 0
+        for path in (pathlib.Path(f"{self._filename}.tmp"), self._filename):
+            try:
+                bytes_out = path.stat().st_size
+                break
+            except OSError:
+                pass
+        return {
+            "items_added": snapshot.itemsAdded,
+            "elapsed": elapsed,
+            "items_per_second": snapshot.itemsAdded / elapsed if elapsed else 0.0,
+            "add_item_time": snapshot.addItemNs / 1e9,
+            "callback_calls": snapshot.callbackCalls,
+            "callback_time": snapshot.callbackNs / 1e9,
+            "gil_wait_time": snapshot.gilWaitNs / 1e9,
+            "finish_time": self._finish_time if self._end_time else None,
+            "bytes_in": snapshot.bytesIn,
+            "bytes_out": bytes_out,
+            "compression": self._compression,
+            "item_queue_depth": self.c_queue.size() if self.c_queue != NULL else 0,
+            "dedup_items": dedup.itemsHashed,
+            "dedup_duplicates": dedup.duplicates,
+            "dedup_bytes_saved": dedup.bytesSaved,
+        }
+
+########################
+#     Reader Stats     #
+########################
+
+cdef enum:
+    # log2 latency buckets: bucket i counts durations under 2**i µs, last is +Inf
+    LATENCY_BUCKETS = 24
+
+
+cdef inline uint64_t monotonic_ns() nogil:
+    cdef timespec ts
+    clock_gettime(CLOCK_MONOTONIC, &ts)
+    return <uint64_t>ts.tv_sec * 1000000000 + <uint64_t>ts.tv_nsec
+
+
+@cython.cdivision(True)
+cdef void record_latency(uint64_t* histogram, uint64_t* total, uint64_t duration):
+    """ Add duration (ns) to histogram, with the GIL held """
+    cdef uint64_t micros = duration // 1000
+    cdef int bucket = 0
+    while micros and bucket < LATENCY_BUCKETS - 1:
+        micros >>= 1
+        bucket += 1
+    histogram[bucket] += 1
+    total[0] += duration
+
+
+cdef class ReaderStats:
+    """ Counters of an Archive's reads (see `Archive.enable_stats()`)
+
+        Updated with the GIL held, so they can be shared by several archives
+        and read from any thread.
+
+        libzim does not report its cluster cache hits: `cluster_decompressions`
+        counts content reads from compressed clusters (and `bytes_decompressed`
+        their size), an upper bound of actual decompressions. Telling those
+        apart costs one more dirent/cluster lookup on the first content read
+        of every Item (only while stats are enabled).
+
+        Attributes
+        ----------
+        lookups_by_path, lookups_by_title : int
+            entries looked up (`has_entry_by_*`, `get_entry(ies)_by_*`)
+        cluster_decompressions : int
+            content reads from compressed clusters
+        bytes_decompressed : int
+            bytes read from compressed clusters
+        blob_bytes : int
+            bytes exposed through memoryviews of content
+        trace : Callable[[str, str, float], None]
+            called with (operation, path, seconds) after each timed
+            `get_entry_by_path` or content read. None to disable """
+    cdef readonly uint64_t lookups_by_path
+    cdef readonly uint64_t lookups_by_title
+    cdef readonly uint64_t cluster_decompressions
+    cdef readonly uint64_t bytes_decompressed
+    cdef readonly uint64_t blob_bytes
+    cdef uint64_t path_latency[LATENCY_BUCKETS]
+    cdef uint64_t path_latency_total
+    cdef uint64_t content_latency[LATENCY_BUCKETS]
+    cdef uint64_t content_latency_total
+    cdef public object trace
+
+    def __init__(self, trace: Optional[Callable[[str, str, float], None]] = None):
+        self.reset()
+        self.trace = trace
+
+    def reset(self):
+        """ Set all counters back to 0 """
+        self.lookups_by_path = self.lookups_by_title = 0
+        self.cluster_decompressions = self.bytes_decompressed = self.blob_bytes = 0
+        memset(self.path_latency, 0, sizeof(self.path_latency))
+        memset(self.content_latency, 0, sizeof(self.content_latency))
+        self.path_latency_total = self.content_latency_total = 0
+
+    cdef path_lookup_done(self, uint64_t start, object path):
+        cdef uint64_t duration = monotonic_ns() - start
+        record_latency(self.path_latency, &self.path_latency_total, duration)
+        self.lookups_by_path += 1
+        if self.trace is not None:
+            self.trace("get_entry_by_path", path, duration / 1e9)
+
+    cdef wrapper.Blob read_content(self, Item item, offset_type offset, size_type size) except *:
+        """ Item's data, timed and accounted -> Blob """
+        cdef wrapper.Blob blob
+        cdef uint64_t start
+        cdef uint64_t duration
+        cdef bint known = item._compressionKnown
+        cdef bint compressed = item._compressed
+        with nogil:
+            start = monotonic_ns()
+            blob = item.c_item.getData(offset, size)
+            duration = monotonic_ns() - start
+            if not known:
+                # no direct access to content in compressed clusters
+                compressed = item.c_item.getDirectAccessInformation().first.empty()
+        # item fields and counters are only changed with the GIL held
+        item._compressed = compressed
+        item._compressionKnown = True
+        record_latency(self.content_latency, &self.content_latency_total, duration)
+        if compressed:
+            self.cluster_decompressions += 1
+            self.bytes_decompressed += blob.size()
+        if self.trace is not None:
+            self.trace("content", item.path, duration / 1e9)
+        return blob
+
+    cdef list _histogram(self, uint64_t* histogram, uint64_t total):
+        """ Cumulated counts per upper bound (seconds) and total seconds """
+        cdef int bucket
+        cdef uint64_t count = 0
+        buckets = []
+        for bucket in range(LATENCY_BUCKETS):
+            count += histogram[bucket]
+            bound = float("inf") if bucket == LATENCY_BUCKETS - 1 else (1 << bucket) / 1e6
+            buckets.append((bound, count))
+        return [buckets, total / 1e9]
+
+    def as_dict(self) -> Dict[str, Any]:
+        """ All counters -> Dict
+
+            Latencies (`get_entry_by_path_latency`, `content_latency`) are
+            `{"buckets": [(upper bound in seconds, cumulated count), ...],
+            "sum": total seconds, "count": number of calls}` """
+        histograms = {}
+        for name, histogram in (
+            ("get_entry_by_path_latency", self._histogram(self.path_latency, self.path_latency_total)),
+            ("content_latency", self._histogram(self.content_latency, self.content_latency_total)),
+        ):
+            buckets, total = histogram
+            histograms[name] = {"buckets": buckets, "sum": total, "count": buckets[-1][1]}
+        return {
+            "lookups_by_path": self.lookups_by_path,
+            "lookups_by_title": self.lookups_by_title,
+            "cluster_decompressions": self.cluster_decompressions,
+            "bytes_decompressed": self.bytes_decompressed,
+            "blob_bytes": self.blob_bytes,
+            **histograms,
+        }
+
+    def to_prometheus(self, str prefix="libzim_reader", labels: Dict[str, str] = None) -> str:
+        """ Counters in Prometheus text exposition format -> str
+
+            Parameters
+            ----------
+            prefix : str
+                Prefix of metrics names
+            labels : Dict[str, str]
+                Labels added to every sample (ie. `{"zim": "wikipedia"}`) """
+        def format_labels(extra=None):
+            items = dict(labels or {})
+            items.update(extra or {})
+            if not items:
+                return ""
+            values = ",".join(
+                '{}="{}"'.format(key, str(value).replace("\\", "\\\\").replace('"', '\\"'))
+                for key, value in items.items())
+            return "{" + values + "}"
+
+        lines = []
+        stats = self.as_dict()
+        for name in ("lookups_by_path", "lookups_by_title", "cluster_decompressions",
+                     "bytes_decompressed", "blob_bytes"):
+            metric = f"{prefix}_{name}_total"
+            lines.append(f"# TYPE {metric} counter")
+            lines.append(f"{metric}{format_labels()} {stats[name]}")
+        for name in ("get_entry_by_path_latency", "content_latency"):
+            metric = f"{prefix}_{name}_seconds"
+            histogram = stats[name]
+            lines.append(f"# TYPE {metric} histogram")
+            for bound, count in histogram["buckets"]:
+                bound = "+Inf" if bound == float("inf") else repr(bound)
+                lines.append(f"{metric}_bucket{format_labels({'le': bound})} {count}")
+            lines.append(f"{metric}_sum{format_labels()} {histogram['sum']!r}")
+            lines.append(f"{metric}_count{format_labels()} {histogram['count']}")
+        return "\n".join(lines) + "\n"
+
+    def __repr__(self):
+        return (f"{self.__class__.__name__}(lookups_by_path={self.lookups_by_path}, "
+                f"lookups_by_title={self.lookups_by_title}, "
+                f"cluster_decompressions={self.cluster_decompressions})")
+
+
 ########################
 #         Entry        #
 ########################
 
+@cython.freelist(16)
 cdef class Entry:
     """ Entry in a Zim archive
 
         Attributes
         ----------
-        *c_entry : Entry (zim::)
-            a pointer to the C++ entry object """
-    cdef wrapper.ZimEntry* c_entry
+        c_entry : Entry (zim::)
+            the C++ entry object, held inline
+        _archive : PyArchive
+            archive of the entry
+        _stats : ReaderStats
+            stats of the archive, None if disabled
+        _title, _path : str
+            decoded on first access
+        _item : Item
+            resolved by `get_item()` """
+    cdef wrapper.ZimEntry c_entry
+    cdef PyArchive _archive
+    cdef ReaderStats _stats
+    cdef object _title
+    cdef object _path
+    cdef Item _item
 
     # Factory functions - Currently Cython can't use classmethods
     @staticmethod
-    cdef from_entry(wrapper.ZimEntry* ent):
+    cdef from_entry(wrapper.ZimEntry ent, PyArchive archive):
         """ Creates a python Entry from a C++ Entry (zim::) -> Entry
 
             Parameters
             ----------
             ent : Entry
                 A C++ Entry
+            archive : PyArchive
+                The archive it comes from
             Returns
             ------
             Entry
                 Casted entry """
         cdef Entry entry = Entry()
         entry.c_entry = ent
+        entry._archive = archive
+        entry._stats = archive._stats
         return entry
 
-    def __dealloc__(self):
-        if self.c_entry != NULL:
-            del self.c_entry
-
     @property
     def title(self) -> str:
-        return self.c_entry.getTitle().decode('UTF-8')
+        if self._title is None:
+            self._title = self.c_entry.getTitle().decode('UTF-8')
+        return self._title
 
     @property
     def path(self) -> str:
-        return self.c_entry.getPath().decode("UTF-8", "strict")
+        if self._path is None:
+            self._path = self.c_entry.getPath().decode("UTF-8", "strict")
+        return self._path
 
     @property
     def _index(self) -> int:
@@ -356,67 +900,268 @@ cdef class Entry:
         return self.c_entry.isRedirect()
 
     def get_redirect_entry(self) -> Entry:
-        cdef ZimEntry* entry = self.c_entry.getRedirectEntry()
-        return Entry.from_entry(entry)
+        cdef wrapper.ZimEntry entry
+        with nogil:
+            entry = self.c_entry.getRedirectEntry()
+        return Entry.from_entry(entry, self._archive)
 
     def get_item(self) -> Item:
-        cdef ZimItem* item = self.c_entry.getItem(True)
-        return Item.from_item(item)
+        """ Item of this entry (following redirects) -> Item
+
+            Resolved once: later calls return the same Item (and its
+            already loaded content) """
+        cdef wrapper.ZimItem item
+        if self._item is None:
+            with nogil:
+                item = self.c_entry.getItem(True)
+            self._item = Item.from_item(item, self._archive)
+        return self._item
 
     def __repr__(self):
         return f"{self.__class__.__name__}(url={self.path}, title={self.title})"
 
+@cython.freelist(16)
 cdef class Item:
     """ Item in a Zim archive
 
         Attributes
         ----------
-        *c_entry : Entry (zim::)
-            a pointer to the C++ entry object """
-    cdef wrapper.ZimItem* c_item
+        c_item : Item (zim::)
+            the C++ item object, held inline
+        _archive : PyArchive
+            archive of the item
+        _stats : ReaderStats
+            stats of the archive, None if disabled
+        _title, _path, _mimetype : str
+            decoded on first access
+        _size : int
+            content size, read on first access (if _haveSize)
+        _compressed : bool
+            content is in a compressed cluster (if _compressionKnown) """
+    cdef wrapper.ZimItem c_item
     cdef ReadingBlob _blob
     cdef bool _haveBlob
+    cdef PyArchive _archive
+    cdef ReaderStats _stats
+    cdef object _title
+    cdef object _path
+    cdef object _mimetype
+    cdef size_type _size
+    cdef bool _haveSize
+    cdef bool _compressionKnown
+    cdef bool _compressed
 
     # Factory functions - Currently Cython can't use classmethods
     @staticmethod
-    cdef from_item(wrapper.ZimItem* _item):
+    cdef from_item(wrapper.ZimItem _item, PyArchive archive):
         """ Creates a python ReadArticle from a C++ Article (zim::) -> ReadArticle
 
             Parameters
             ----------
             _item : Item
                 A C++ Item
+            archive : PyArchive
+                The archive it comes from
             Returns
             ------
             Item
                 Casted item """
         cdef Item item = Item()
         item.c_item = _item
+        item._archive = archive
+        item._stats = archive._stats
         return item
 
-    def __dealloc__(self):
-        if self.c_item != NULL:
-            del self.c_item
-
     @property
     def title(self) -> str:
-        return self.c_item.getTitle().decode('UTF-8')
+        if self._title is None:
+            self._title = self.c_item.getTitle().decode('UTF-8')
+        return self._title
 
     @property
     def path(self) -> str:
-        return self.c_item.getPath().decode("UTF-8", "strict")
+        if self._path is None:
+            self._path = self.c_item.getPath().decode("UTF-8", "strict")
+        return self._path
+
+    cdef _set_content(self, wrapper.Blob blob):
+        self._blob = ReadingBlob()
+        self._blob.__setup(blob)
+        self._blob.stats = self._stats
+        self._haveBlob = True
 
     @property
     def content(self) -> memoryview:
+        cdef wrapper.Blob blob
         if not self._haveBlob:
-            self._blob = ReadingBlob()
-            self._blob.__setup(self.c_item.getData(<int> 0))
-            self._haveBlob = True
+            if self._stats is not None:
+                blob = self._stats.read_content(self, 0, self.size)
+            else:
+                # may decompress a whole cluster
+                with nogil:
+                    blob = self.c_item.getData(<offset_type> 0)
+            self._set_content(blob)
         return memoryview(self._blob)
 
+    def read(self, offset: int = 0, size: Optional[int] = None) -> memoryview:
+        """ Part of the item's content -> memoryview
+
+            Only the requested range is read from uncompressed clusters.
+
+            Parameters
+            ----------
+            offset : int
+                Position of the first byte to read (default 0)
+            size : int
+                Number of bytes to read (default: up to the end of content).
+                Reading past the end returns less bytes.
+            Returns
+            -------
+            memoryview
+                Requested content range
+            Raises
+            ------
+                ValueError
+                    If offset is negative or past the end of content """
+        cdef wrapper.Blob blob
+        cdef ReadingBlob reading_blob
+        cdef size_type total_size
+        cdef offset_type _offset
+        cdef size_type _size
+        if offset < 0 or (size is not None and size < 0):
+            raise ValueError("offset and size must be positive")
+        total_size = self.size
+        if offset > total_size:
+            raise ValueError(f"offset {offset} is beyond item size {total_size}")
+        _offset = offset
+        _size = total_size - _offset
+        if size is not None and size < _size:
+            _size = size
+        if self._stats is not None:
+            blob = self._stats.read_content(self, _offset, _size)
+        else:
+            with nogil:
+                blob = self.c_item.getData(_offset, _size)
+        reading_blob = ReadingBlob()
+        reading_blob.__setup(blob)
+        reading_blob.stats = self._stats
+        return memoryview(reading_blob)
+
+    def open(self) -> ItemReader:
+        """ Content as a read-only, seekable binary file -> ItemReader
+
+            Reads go straight into the caller's buffer (`readinto()`), by
+            chunks, without keeping the content in memory: suitable for
+            `shutil.copyfileobj()` or hashing of huge items. """
+        return ItemReader(self)
+
+    cdef size_type _readinto(self, object buffer, offset_type offset) except? 0:
+        """ Copy content at offset into writable buffer -> bytes copied """
+        cdef Py_buffer view
+        cdef size_type copied
+        PyObject_GetBuffer(buffer, &view, PyBUF_SIMPLE | PyBUF_WRITABLE)
+        try:
+            with nogil:
+                copied = self.c_item.readInto(<char*>view.buf, offset, view.len)
+        finally:
+            PyBuffer_Release(&view)
+        return copied
+
+    def iter_content(self, size_t chunk_size=1048576) -> Generator[memoryview, None, None]:
+        """ Item's content by successive chunks -> Generator[memoryview, None, None]
+
+            Parameters
+            ----------
+            chunk_size : int
+                Maximum size of each chunk (default 1MiB) """
+        if not chunk_size:
+            raise ValueError("chunk_size must be positive")
+        offset = 0
+        total_size = self.size
+        while offset < total_size:
+            chunk = self.read(offset, chunk_size)
+            offset += chunk.nbytes
+            yield chunk
+
+    def sendfile(self, fd, offset: int = 0, size: Optional[int] = None) -> int:
+        """ Write (part of) item's content to a file descriptor -> int
+
+            Uncompressed content goes straight from the ZIM file to `fd` using
+            sendfile() (on Linux) without being copied into Python.
+            Compressed content is written from libzim's buffer.
+            If `fd` is a Python file object, flush it before calling this.
+
+            Parameters
+            ----------
+            fd : int
+                File descriptor (or object with a `fileno()` method) of a
+                file, pipe or socket
+            offset : int
+                Position of the first byte to send (default 0)
+            size : int
+                Number of bytes to send (default: up to the end of content)
+            Returns
+            -------
+            int
+                Number of bytes written. Can be less than requested if `fd`
+                is non-blocking, as with `os.sendfile()`
+            Raises
+            ------
+                BlockingIOError
+                    If `fd` is non-blocking and nothing could be written """
+        cdef int _fd = fd if isinstance(fd, int) else fd.fileno()
+        cdef offset_type _offset
+        cdef size_type _size
+        cdef size_type written
+        cdef bool would_block = False
+        if offset < 0 or (size is not None and size < 0):
+            raise ValueError("offset and size must be positive")
+        _offset = offset
+        _size = self.size if size is None else size
+        with nogil:
+            written = self.c_item.sendTo(_fd, _offset, _size, would_block)
+        if would_block and not written:
+            raise BlockingIOError(errno.EAGAIN, os.strerror(errno.EAGAIN))
+        return written
+
+    def get_direct_access_information(self) -> Optional[Tuple[pathlib.Path, int]]:
+        """ Where item's content lies on the filesystem -> Optional[Tuple[Path, int]]
+
+            Only available for items stored in uncompressed clusters, so content
+            can be read (or sent) straight from the file.
+
+            Returns
+            -------
+            Tuple[pathlib.Path, int]
+                Path of the file (part for split archives) and offset of the
+                content in it. None if content is compressed. """
+        cdef pair[string, offset_type] info
+        with nogil:
+            info = self.c_item.getDirectAccessInformation()
+        if info.first.empty():
+            return None
+        return pathlib.Path(info.first.decode("UTF-8", "strict")), info.second
+
     @property
     def mimetype(self) -> str:
-        return self.c_item.getMimetype().decode('UTF-8')
+        if self._mimetype is None:
+            self._mimetype = self.c_item.getMimetype().decode('UTF-8')
+        return self._mimetype
+
+    @property
+    def mimetype_index(self) -> int:
+        """ Index of the item's mimetype in `Archive.mimetypes` -> int
+
+            Constant for a given archive, to dispatch on mimetype without
+            comparing strings. Derived from the mimetype (looked up natively,
+            without decoding it) as libzim does not expose the dirent's own
+            index: they match in valid archives. -1 if not in the list """
+        cdef unordered_map[string, int].iterator it
+        self._archive._read_mimetypes()
+        it = self._archive._mimetype_indexes.find(self.c_item.getMimetype())
+        if it == self._archive._mimetype_indexes.end():
+            return -1
+        return dereference(it).second
 
     @property
     def _index(self) -> int:
@@ -424,18 +1169,262 @@ cdef class Item:
 
     @property
     def size(self) -> int:
-        return self.c_item.getSize()
+        # may read (and decompress) the cluster: without the GIL, once
+        cdef size_type size
+        if not self._haveSize:
+            with nogil:
+                size = self.c_item.getSize()
+            self._size = size
+            self._haveSize = True
+        return self._size
 
     def __repr__(self):
         return f"{self.__class__.__name__}(url={self.path}, title={self.title})"
 
 
+class ItemReader(io.RawIOBase):
+    """ Read-only binary file over an Item's content (see `Item.open()`)
+
+        Each `readinto()` copies the requested range from libzim without
+        the GIL. Uncompressed content is read from the file range by range;
+        compressed content comes from libzim's (cached) cluster. """
+
+    def __init__(self, Item item not None):
+        super().__init__()
+        self._item = item
+        self._size = item.size
+        self._pos = 0
+
+    @property
+    def item(self) -> Item:
+        return self._item
+
+    def readable(self) -> bool:
+        return True
+
+    def seekable(self) -> bool:
+        return True
+
+    def seek(self, offset: int, whence: int = io.SEEK_SET) -> int:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        if whence == io.SEEK_SET:
+            pos = offset
+        elif whence == io.SEEK_CUR:
+            pos = self._pos + offset
+        elif whence == io.SEEK_END:
+            pos = self._size + offset
+        else:
+            raise ValueError(f"invalid whence ({whence})")
+        if pos < 0:
+            raise ValueError(f"negative seek position {pos}")
+        self._pos = pos
+        return pos
+
+    def tell(self) -> int:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        return self._pos
+
+    def readinto(self, buffer) -> int:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        copied = (<Item>self._item)._readinto(buffer, self._pos)
+        self._pos += copied
+        return copied
+
+    def readall(self) -> bytes:
+        if self.closed:
+            raise ValueError("I/O operation on closed file")
+        if self._pos >= self._size:
+            return b""
+        data = bytes(self._item.read(self._pos))
+        self._pos += len(data)
+        return data
+
+
+cdef class EntryIterator:
+    """ Iterator over all the entries of an Archive, in a given order
+
+        Entries are fetched from libzim by chunks of `chunk_size`, without
+        the GIL. Use `next_chunk()` to get them as lists.
+
+        Attributes
+        ----------
+        *c_iter : ZimEntryIterator
+            a pointer to the C++ iterator
+        c_chunk : vector[ZimEntry]
+            current chunk of entries """
+    cdef wrapper.ZimEntryIterator* c_iter
+    cdef vector[wrapper.ZimEntry] c_chunk
+    cdef size_t _pos
+    cdef size_t _chunk_size
+    cdef PyArchive _archive
+
+    @staticmethod
+    cdef from_iterator(wrapper.ZimEntryIterator* it, size_t chunk_size,
+                       PyArchive archive):
+        cdef EntryIterator iterator = EntryIterator()
+        iterator.c_iter = it
+        iterator._chunk_size = chunk_size if chunk_size else 1
+        iterator._archive = archive
+        return iterator
+
+    def __dealloc__(self):
+        if self.c_iter != NULL:
+            del self.c_iter
+
+    cdef int _fill(self) except -1:
+        """ Replace current chunk with the next one. 0 if iterator is exhausted """
+        self.c_chunk.clear()
+        self._pos = 0
+        with nogil:
+            self.c_iter.fill(self.c_chunk, self._chunk_size)
+        return not self.c_chunk.empty()
+
+    def __iter__(self):
+        return self
+
+    def __next__(self) -> Entry:
+        if self._pos >= self.c_chunk.size() and not self._fill():
+            raise StopIteration
+        self._pos += 1
+        return Entry.from_entry(self.c_chunk[self._pos - 1], self._archive)
+
+    def next_chunk(self) -> List[Entry]:
+        """ Next (up to `chunk_size`) entries -> List[Entry]
+
+            Returns an empty list once all entries have been returned """
+        if self._pos >= self.c_chunk.size() and not self._fill():
+            return []
+        entries = [
+            Entry.from_entry(self.c_chunk[pos], self._archive)
+            for pos in range(self._pos, self.c_chunk.size())]
+        self._pos = self.c_chunk.size()
+        return entries
 
 
 #########################
 #        Archive        #
 #########################
 
+# templates for batch lookups results
+cdef array.array _index_array = array.array('I')
+cdef array.array _flag_array = array.array('B')
+
+# Native threads of the task pool of each event loop (see AsyncTasks)
+ASYNC_READER_THREADS = min(8, (os.cpu_count() or 1) + 2)
+
+
+cdef class AsyncTasks:
+    """ Native task pool reporting to an asyncio event loop
+
+        Tasks run without the GIL on the pool threads ; the loop watches the
+        pool's pipe (add_reader) and resolves futures of completed tasks.
+        Cancelled futures are forgotten at once: pending ones hold a
+        reference to their loop, see `shutdown()`. """
+
+    cdef unique_ptr[wrapper.ZimTaskPool] c_pool
+    cdef dict _futures
+    cdef uint64_t _next_id
+
+    def __cinit__(self, size_t nb_threads):
+        self.c_pool.reset(new wrapper.ZimTaskPool(nb_threads))
+        self._futures = {}
+        self._next_id = 0
+
+    def fileno(self) -> int:
+        return self.c_pool.get().getFd()
+
+    cdef submit(self, object loop, PyArchive archive, str path, bint with_item):
+        cdef string _path = path.encode('UTF-8')
+        future = loop.create_future()
+        self._next_id += 1
+        self.c_pool.get().getEntryByPath(self._next_id, archive.c_shared, _path, with_item)
+        self._futures[self._next_id] = future, archive
+        future.add_done_callback(functools.partial(self._forget, self._next_id))
+        if archive._stats is not None:
+            archive._stats.lookups_by_path += 1
+        return future
+
+    def _forget(self, uint64_t task_id, future):
+        if future.cancelled():
+            self._futures.pop(task_id, None)
+
+    def shutdown(self, loop):
+        """ Stop watching the pool from `loop` and cancel pending futures """
+        futures, self._futures = self._futures, {}
+        if loop.is_closed():
+            # can't run callbacks anymore: just drop them
+            return
+        loop.remove_reader(self.fileno())
+        for future, _ in futures.values():
+            future.cancel()
+
+    def _on_ready(self):
+        cdef vector[wrapper.ZimTaskResult] results = self.c_pool.get().popResults()
+        cdef size_t index
+        cdef Item item
+        for index in range(results.size()):
+            future, archive = self._futures.pop(results[index].id, (None, None))
+            if future is None or future.done():
+                # cancelled
+                continue
+            if results[index].notFound:
+                future.set_exception(KeyError(results[index].error.decode('UTF-8', 'replace')))
+            elif not results[index].error.empty():
+                future.set_exception(RuntimeError(results[index].error.decode('UTF-8', 'replace')))
+            elif results[index].withItem:
+                item = Item.from_item(results[index].item, archive)
+                item._set_content(results[index].content)
+                future.set_result(item)
+            else:
+                future.set_result(Entry.from_entry(results[index].entry, archive))
+
+
+# AsyncTasks of each event loop
+_async_tasks = weakref.WeakKeyDictionary()
+
+
+cdef AsyncTasks get_async_tasks(object loop):
+    # pools of closed loops are shut down (there is no hook on close)
+    for other_loop, other_tasks in list(_async_tasks.items()):
+        if other_loop.is_closed():
+            (<AsyncTasks>other_tasks).shutdown(other_loop)
+            del _async_tasks[other_loop]
+    tasks = _async_tasks.get(loop)
+    if tasks is None:
+        tasks = AsyncTasks(ASYNC_READER_THREADS)
+        loop.add_reader(tasks.fileno(), tasks._on_ready)
+        _async_tasks[loop] = tasks
+    return tasks
+
+
+# libzim defaults, used when not set in environment (ZIM_CLUSTERCACHE...)
+DEFAULT_CLUSTER_CACHE_SIZE = 16
+DEFAULT_DIRENT_CACHE_SIZE = 512
+
+
+cdef int cache_size_from_env(str name, int default):
+    try:
+        return int(os.environ.get(name, default))
+    except ValueError:
+        return default
+
+
+cdef str archive_key(object filename):
+    """ Key of an archive in the shared archives, None if it can't be shared
+
+        Includes file identity so that a replaced file is opened again """
+    try:
+        path = os.path.realpath(filename)
+        stat = os.stat(path)
+    except (OSError, ValueError):
+        # multipart ZIM (.zimaa, .zimab...) or invalid path
+        return None
+    return f"{path}:{stat.st_dev}:{stat.st_ino}:{stat.st_mtime_ns}:{stat.st_size}"
+
+
 cdef class PyArchive:
     """ Zim Archive Reader
 
@@ -443,46 +1432,162 @@ cdef class PyArchive:
         ----------
         *c_archive : Archive
             a pointer to a C++ Archive object
+        c_shared : shared_ptr[ZimArchive]
+            owner of c_archive, possibly shared with other PyArchive
         _filename : pathlib.Path
-            the file name of the Archive Reader object """
+            the file name of the Archive Reader object
+        _stats : ReaderStats
+            counters of reads from this archive, None if disabled
+        _mimetypes : tuple
+            mimetypes listed in the header, read on first use
+        _mimetype_indexes : unordered_map[string, int]
+            index of each (raw) mimetype in `_mimetypes`
+        _metadata_keys : tuple
+            names of metadata, read on first use
+        _uuid_bytes, _uuid, _resolved
+            identity of the archive, computed on first use """
 
     cdef wrapper.ZimArchive* c_archive
+    cdef shared_ptr[wrapper.ZimArchive] c_shared
     cdef object _filename
-
-    def __cinit__(self, object filename: pathlib.Path):
+    cdef object _searcher
+    cdef int _cluster_cache_size
+    cdef int _dirent_cache_size
+    cdef ReaderStats _stats
+    cdef tuple _mimetypes
+    cdef unordered_map[string, int] _mimetype_indexes
+    cdef tuple _metadata_keys
+    cdef bytes _uuid_bytes
+    cdef object _uuid
+    cdef str _resolved
+
+    def __cinit__(self, object filename: pathlib.Path, bint shared=False, bint prefault=False,
+                  int cluster_cache_size=0, int dirent_cache_size=0):
         """ Constructs an Archive from full zim file path
 
             Parameters
             ----------
             filename : pathlib.Path
-                Full path to a zim file """
+                Full path to a zim file
+            shared : bool
+                reuse the archive already opened (and its caches) by other
+                shared `Archive` of the same file (same path, inode, mtime
+                and size), in this process. Default: False
+            prefault : bool
+                ask the kernel to read the index parts of the file now
+                (page cache is shared by all processes). Default: False
+            cluster_cache_size : int
+                number of (uncompressed) clusters libzim keeps in cache.
+                Default (0): ZIM_CLUSTERCACHE env var or libzim default (16)
+            dirent_cache_size : int
+                number of dirents libzim keeps in cache.
+                Default (0): ZIM_DIRENTCACHE env var or libzim default (512) """
+
+        if cluster_cache_size < 0 or dirent_cache_size < 0:
+            raise ValueError("Cache sizes must be positive (or 0 for default)")
+        self._cluster_cache_size = cluster_cache_size or cache_size_from_env(
+            "ZIM_CLUSTERCACHE", DEFAULT_CLUSTER_CACHE_SIZE)
+        self._dirent_cache_size = dirent_cache_size or cache_size_from_env(
+            "ZIM_DIRENTCACHE", DEFAULT_DIRENT_CACHE_SIZE)
+
+        cdef string _filename = str(filename).encode('UTF-8')
+        cdef string _key
+        if shared:
+            key = archive_key(str(filename))
+            if key is not None:
+                # archives with different caches can't be shared
+                key += f":{self._cluster_cache_size}:{self._dirent_cache_size}"
+                _key = key.encode('UTF-8')
+        if prefault:
+            with nogil:
+                wrapper.prefaultArchive(_filename)
+        if cluster_cache_size or dirent_cache_size:
+            # sizes are given to libzim through the process environment:
+            # keep the GIL so that no Python thread changes it meanwhile
+            self.c_shared = wrapper.openArchive(
+                _filename, _key, cluster_cache_size, dirent_cache_size)
+        else:
+            with nogil:
+                self.c_shared = wrapper.openArchive(_filename, _key, 0, 0)
+        self.c_archive = self.c_shared.get()
+        self._filename = pathlib.Path(str(filename))
 
-        self.c_archive = new wrapper.ZimArchive(str(filename).encode('UTF-8'))
-        self._filename = pathlib.Path(self.c_archive.getFilename().decode("UTF-8", "strict"))
-
-    def __dealloc__(self):
-        if self.c_archive != NULL:
-            del self.c_archive
+    cdef str _resolved_filename(self):
+        """ Absolute path of the file, symlinks resolved (once) """
+        if self._resolved is None:
+            self._resolved = str(self.filename.expanduser().resolve())
+        return self._resolved
 
     def __eq__(self, other):
-        if PyArchive not in type(self).mro() or PyArchive not in type(other).mro():
+        """ Same file (and content): same UUID then same resolved filename """
+        if not isinstance(self, PyArchive) or not isinstance(other, PyArchive):
+            return False
+        if (<PyArchive>self).uuid_bytes != (<PyArchive>other).uuid_bytes:
             return False
         try:
+            if type(self).filename is PyArchive.filename and type(other).filename is PyArchive.filename:
+                return (<PyArchive>self)._resolved_filename() == (<PyArchive>other)._resolved_filename()
+            # filename overridden by a subclass
             return self.filename.expanduser().resolve() == other.filename.expanduser().resolve()
         except Exception:
             return False
 
+    def __hash__(self):
+        return hash(self.uuid_bytes)
+
     @property
     def filename(self) -> pathlib.Path:
         return self._filename
 
+    @property
+    def cache_sizes(self) -> Dict[str, int]:
+        """ Maximum sizes of libzim caches of this archive -> Dict
+
+            `{"cluster": number of clusters, "dirent": number of dirents}`,
+            as configured. This is not cache usage: libzim does not expose
+            hits, misses or evictions of its caches, so no such counters are
+            reported (see `ReaderStats` for reads of the archive) """
+        return {"cluster": self._cluster_cache_size, "dirent": self._dirent_cache_size}
+
+    @property
+    def stats(self) -> Optional[ReaderStats]:
+        """ Counters of reads from this archive, None unless enabled """
+        return self._stats
+
+    def enable_stats(self, ReaderStats stats=None) -> ReaderStats:
+        """ Start counting lookups and content reads -> ReaderStats
+
+            Entries and items obtained afterwards (and until disabled) report
+            to the returned stats. Disabled by default: it then costs a single
+            check per call.
+
+            Parameters
+            ----------
+            stats : ReaderStats
+                Stats to report to, to aggregate several archives.
+                Default: current stats (or new ones if disabled) """
+        if stats is None:
+            stats = self._stats if self._stats is not None else ReaderStats()
+        self._stats = stats
+        return stats
+
+    def disable_stats(self):
+        """ Stop counting lookups and reads of this archive """
+        self._stats = None
+
     @property
     def filesize(self) -> int:
         """ total size of ZIM file (or files if split """
         return self.c_archive.getFilesize()
 
     def has_entry_by_path(self, path: str) -> bool:
-        return self.c_archive.hasEntryByPath(<string>path.encode('UTF-8'))
+        cdef string _path = path.encode('UTF-8')
+        cdef bool res
+        with nogil:
+            res = self.c_archive.hasEntryByPath(_path)
+        if self._stats is not None:
+            self._stats.lookups_by_path += 1
+        return res
 
     def get_entry_by_path(self, path: str) -> Entry:
         """ Entry from a path -> Entry
@@ -499,15 +1604,81 @@ cdef class PyArchive:
             ------
                 KeyError
                     If an entry with the provided path is not found in the archive """
-        cdef wrapper.ZimEntry* entry
+        cdef string _path = path.encode('UTF-8')
+        cdef wrapper.ZimEntry entry
+        cdef uint64_t start = 0
+        if self._stats is not None:
+            start = monotonic_ns()
         try:
-            entry = self.c_archive.getEntryByPath(<string>path.encode('UTF-8'))
+            with nogil:
+                entry = self.c_archive.getEntryByPath(_path)
         except RuntimeError as e:
             raise KeyError(str(e))
-        return Entry.from_entry(entry)
+        finally:
+            if self._stats is not None:
+                self._stats.path_lookup_done(start, path)
+        return Entry.from_entry(entry, self)
+
+    def aget_entry_by_path(self, str path not None) -> Awaitable[Entry]:
+        """ Entry from a path, looked up on a native thread -> Awaitable[Entry]
+
+            To await from a running asyncio event loop.
+
+            Raises
+            ------
+                KeyError
+                    If an entry with the provided path is not found in the archive """
+        loop = asyncio.get_running_loop()
+        return get_async_tasks(loop).submit(loop, self, path, False)
+
+    def aget_item(self, str path not None) -> Awaitable[Item]:
+        """ Item (content loaded) from a path, on a native thread -> Awaitable[Item]
+
+            To await from a running asyncio event loop. Redirects are followed.
+            Lookup and decompression run without the GIL, outside the loop.
+
+            Raises
+            ------
+                KeyError
+                    If an entry with the provided path is not found in the archive """
+        loop = asyncio.get_running_loop()
+        return get_async_tasks(loop).submit(loop, self, path, True)
+
+    def prefetch(self, paths: Iterable[str], bint advise=True) -> int:
+        """ Warm caches for entries about to be read -> int
+
+            Returns immediately. Entries are resolved on a background native
+            thread: clusters of compressed items are decompressed in libzim's
+            cluster cache and, if `advise`, the kernel is asked to read ahead
+            the content of uncompressed items.
+            A hint only: missing paths are ignored and paths are dropped
+            while too many are pending. Prefetching more items than the
+            cluster cache holds (`cluster_cache_size`) is useless.
+
+            Parameters
+            ----------
+            paths : Iterable[str]
+                Paths of the entries (ie. resources of a page being served)
+            advise : bool
+                Ask for kernel readahead of uncompressed content (default)
+            Returns
+            -------
+            int
+                Number of paths queued """
+        cdef vector[string] _paths = [path.encode('UTF-8') for path in paths]
+        cdef size_t queued
+        with nogil:
+            queued = wrapper.prefetchEntries(self.c_shared, _paths, advise)
+        return queued
 
     def has_entry_by_title(self, title: str) -> bool:
-        return self.c_archive.hasEntryByTitle(<string>title.encode('UTF-8'))
+        cdef string _title = title.encode('UTF-8')
+        cdef bool res
+        with nogil:
+            res = self.c_archive.hasEntryByTitle(_title)
+        if self._stats is not None:
+            self._stats.lookups_by_title += 1
+        return res
 
     def get_entry_by_title(self, title: str) -> Entry:
         """ Entry from a title -> Entry
@@ -524,17 +1695,144 @@ cdef class PyArchive:
             ------
                 KeyError
                     If an entry with the provided title is not found in the archive """
-        cdef wrapper.ZimEntry* entry
+        cdef string _title = title.encode('UTF-8')
+        cdef wrapper.ZimEntry entry
+        if self._stats is not None:
+            self._stats.lookups_by_title += 1
         try:
-            entry = self.c_archive.getEntryByTitle(<string>title.encode('UTF-8'))
+            with nogil:
+                entry = self.c_archive.getEntryByTitle(_title)
         except RuntimeError as e:
             raise KeyError(str(e))
-        return Entry.from_entry(entry)
+        return Entry.from_entry(entry, self)
+
+    def get_entries_by_path(self, paths: Iterable[str]) -> Tuple[array.array, array.array, array.array]:
+        """ Resolve many paths at once -> (indexes, redirects, missing)
+
+            The whole batch is looked up in C++ without the GIL and without
+            creating any Entry object.
+
+            Parameters
+            ----------
+            paths : Iterable[str]
+                Paths of the entries to look for
+            Returns
+            -------
+            Tuple[array.array, array.array, array.array]
+                Three arrays with one value per path: the entry index (`I`),
+                whether the entry is a redirect (`B`) and whether
+                no entry exists at this path (`B`) """
+        cdef vector[string] _paths = [path.encode('UTF-8') for path in paths]
+        cdef Py_ssize_t nb = _paths.size()
+        cdef array.array indexes = array.clone(_index_array, nb, True)
+        cdef array.array redirects = array.clone(_flag_array, nb, True)
+        cdef array.array missing = array.clone(_flag_array, nb, True)
+        with nogil:
+            self.c_archive.getEntriesByPath(
+                _paths, <entry_index_type*>indexes.data.as_uints,
+                redirects.data.as_uchars, missing.data.as_uchars)
+        if self._stats is not None:
+            self._stats.lookups_by_path += nb
+        return indexes, redirects, missing
+
+    def get_entries_by_index(self, entry_ids: Iterable[int]) -> Tuple[array.array, array.array, array.array]:
+        """ Resolve many entry indexes at once -> (indexes, redirects, missing)
+
+            Same as `get_entries_by_path()` but using entries indexes (any
+            iterable of int, like an `array.array('I')`). Out of range indexes
+            are reported as missing. """
+        cdef vector[entry_index_type] _entry_ids = entry_ids
+        cdef Py_ssize_t nb = _entry_ids.size()
+        cdef array.array indexes = array.clone(_index_array, nb, True)
+        cdef array.array redirects = array.clone(_flag_array, nb, True)
+        cdef array.array missing = array.clone(_flag_array, nb, True)
+        with nogil:
+            self.c_archive.getEntriesByIndex(
+                _entry_ids, <entry_index_type*>indexes.data.as_uints,
+                redirects.data.as_uchars, missing.data.as_uchars)
+        return indexes, redirects, missing
+
+    cdef _read_mimetypes(self):
+        """ Read mime list of the header (once) """
+        cdef string _filename
+        cdef vector[string] mimetypes
+        cdef size_t index
+        if self._mimetypes is not None:
+            return
+        _filename = self.c_archive.getFilename()
+        with nogil:
+            mimetypes = wrapper.readMimeTypes(_filename)
+        for index in range(mimetypes.size()):
+            self._mimetype_indexes[mimetypes[index]] = index
+        self._mimetypes = tuple(mimetype.decode("UTF-8") for mimetype in mimetypes)
+
+    @property
+    def mimetypes(self) -> List[str]:
+        """ Mimetypes used in this archive, in libzim's order (see `Item.mimetype_index`) """
+        self._read_mimetypes()
+        return list(self._mimetypes)
 
     @property
     def metadata_keys(self):
         """ List[str] of Metadata present in this archive """
-        return [key.decode("UTF-8", "strict") for key in self.c_archive.getMetadataKeys()]
+        cdef vector[string] keys
+        if self._metadata_keys is None:
+            with nogil:
+                keys = self.c_archive.getMetadataKeys()
+            self._metadata_keys = tuple(key.decode("UTF-8", "strict") for key in keys)
+        return list(self._metadata_keys)
+
+    def get_metadata_item(self, name: str) -> Item:
+        """ A Metadata's Item -> Item
+
+            Its `content` is a memoryview on libzim's buffer: large metadata
+            (ie. Illustration) is not copied.
+
+            Raises
+            ------
+                KeyError
+                    If there is no such metadata """
+        cdef string _name = name.encode('UTF-8')
+        cdef wrapper.ZimItem item
+        try:
+            with nogil:
+                item = self.c_archive.getMetadataItem(_name)
+        except RuntimeError as e:
+            raise KeyError(str(e))
+        return Item.from_item(item, self)
+
+    def metadata_snapshot(self, names: Optional[Iterable[str]] = None) -> Dict[str, memoryview]:
+        """ Content of several (default: all) Metadata at once -> Dict[str, memoryview]
+
+            All metadata are read in a single call without the GIL. Contents
+            are memoryviews on libzim's buffers (use `bytes()` or
+            `str(view, "UTF-8")` to convert).
+
+            Parameters
+            ----------
+            names : Iterable[str]
+                Names of the metadata to read. Missing ones are not in the
+                result. Default: all metadata
+            Returns
+            -------
+            Dict[str, memoryview]
+                Content of each metadata, by name """
+        cdef vector[string] _names
+        cdef vector[pair[string, wrapper.Blob]] snapshot
+        cdef ReadingBlob blob
+        cdef size_t index
+        if names is not None:
+            _names = [name.encode('UTF-8') for name in names]
+            if _names.empty():
+                return {}
+        with nogil:
+            snapshot = self.c_archive.getMetadataSnapshot(_names)
+        result = {}
+        for index in range(snapshot.size()):
+            blob = ReadingBlob()
+            blob.__setup(snapshot[index].second)
+            result[snapshot[index].first.decode("UTF-8", "strict")] = memoryview(blob)
+        return result
 
     def get_metadata(self, name: str) -> bytes:
         """ A Metadata's content -> bytes
@@ -547,11 +1845,48 @@ cdef class PyArchive:
             -------
             bytes
                 Metadata entry's content. Can be of any type. """
-        return bytes(self.c_archive.getMetadata(name.encode('UTF-8')))
+        cdef string _name = name.encode('UTF-8')
+        cdef string content
+        with nogil:
+            content = self.c_archive.getMetadata(_name)
+        return bytes(content)
 
     def _get_entry_by_id(self, entry_id: int) -> Entry:
-        cdef wrapper.ZimEntry* entry = self.c_archive.getEntryByPath(<entry_index_type>entry_id)
-        return Entry.from_entry(entry)
+        cdef entry_index_type _entry_id = <entry_index_type>entry_id
+        cdef wrapper.ZimEntry entry
+        with nogil:
+            entry = self.c_archive.getEntryByPath(_entry_id)
+        return Entry.from_entry(entry, self)
+
+    def iter_by_path(self, size_t chunk_size=256) -> EntryIterator:
+        """ All entries, sorted by path -> EntryIterator
+
+            Parameters
+            ----------
+            chunk_size : int
+                Number of entries fetched from libzim at once """
+        return EntryIterator.from_iterator(self.c_archive.iterByPath(), chunk_size, self)
+
+    def iter_by_title(self, size_t chunk_size=256) -> EntryIterator:
+        """ All entries, sorted by title -> EntryIterator
+
+            Parameters
+            ----------
+            chunk_size : int
+                Number of entries fetched from libzim at once """
+        return EntryIterator.from_iterator(self.c_archive.iterByTitle(), chunk_size, self)
+
+    def iter_efficient(self, size_t chunk_size=256) -> EntryIterator:
+        """ All entries, in cluster order -> EntryIterator
+
+            Fastest way to read the content of all items as each cluster
+            is decompressed only once.
+
+            Parameters
+            ----------
+            chunk_size : int
+                Number of entries fetched from libzim at once """
+        return EntryIterator.from_iterator(self.c_archive.iterEfficient(), chunk_size, self)
 
     @property
     def has_main_entry(self) -> bool:
@@ -559,7 +1894,10 @@ cdef class PyArchive:
 
     @property
     def main_entry(self) -> Entry:
-        return Entry.from_entry(self.c_archive.getMainEntry())
+        cdef wrapper.ZimEntry entry
+        with nogil:
+            entry = self.c_archive.getMainEntry()
+        return Entry.from_entry(entry, self)
 
     @property
     def has_favicon_entry(self) -> bool:
@@ -567,11 +1905,23 @@ cdef class PyArchive:
 
     @property
     def favicon_entry(self) -> Entry:
-        return Entry.from_entry(self.c_archive.getFaviconEntry())
+        cdef wrapper.ZimEntry entry
+        with nogil:
+            entry = self.c_archive.getFaviconEntry()
+        return Entry.from_entry(entry, self)
 
     @property
     def uuid(self) -> UUID:
-        return UUID(self.c_archive.getUuid().hex())
+        if self._uuid is None:
+            self._uuid = UUID(bytes=self.uuid_bytes)
+        return self._uuid
+
+    @property
+    def uuid_bytes(self) -> bytes:
+        """ The 16 bytes of the archive's UUID """
+        if self._uuid_bytes is None:
+            self._uuid_bytes = self.c_archive.getUuid()
+        return self._uuid_bytes
 
     @property
     def has_new_namespace_scheme(self) -> bool:
@@ -597,9 +1947,39 @@ cdef class PyArchive:
     def checksum(self) -> str:
         return self.c_archive.getChecksum().decode("UTF-8", "strict")
 
-    def check(self) -> bool:
-        """ whether Archive has a checksum anf file verifies it """
-        return self.c_archive.check()
+    def check(self, progress: Optional[Callable[[int, int], Any]] = None,
+              float interval=0.5) -> bool:
+        """ whether Archive has a checksum anf file verifies it
+
+            Parameters
+            ----------
+            progress : Callable[[int, int], Any], optional
+                called every `interval` seconds (and on completion) from the
+                calling thread with (processed, total) bytes. Returning False
+                cancels the check. The check then runs as a `Checker`
+            interval : float
+                seconds between two progress calls (default 0.5)
+            Raises
+            ------
+                RuntimeError
+                    If the check is cancelled or file can't be read (with progress) """
+        cdef bool res
+        if progress is None:
+            # reads (and hashes) the whole file
+            with nogil:
+                res = self.c_archive.check()
+            return res
+
+        checker = Checker(self)
+        checker.start()
+        try:
+            while not checker.wait(interval):
+                if progress(*checker.progress) is False:
+                    checker.cancel()
+            progress(*checker.progress)
+            return checker.result
+        finally:
+            checker.cancel()
 
     @property
     def entry_count(self) -> int:
@@ -620,15 +2000,8 @@ cdef class PyArchive:
             -------
             Generator
                 Path of suggested entry """
-        cdef wrapper.ZimSearch search = wrapper.ZimSearch(dereference(self.c_archive))
-        search.set_suggestion_mode(True)
-        search.set_query(query.encode('UTF-8'))
-        search.set_range(start, end)
-
-        cdef wrapper.search_iterator it = search.begin()
-        while it != search.end():
-            yield it.get_path().decode('UTF-8')
-            preincrement(it)
+        search = self._get_searcher().suggest(Query().set_query(query))
+        yield from search.get_results(start, max(end - start, 0))
 
     def search(self, query: str, start: int = 0, end: int = 10) -> Generator[str, None, None]:
         """ Paths of entries in the archive from a search query -> Generator[str, None, None]
@@ -645,16 +2018,8 @@ cdef class PyArchive:
             -------
             Generator
                 Path of entry matching the search query """
-
-        cdef wrapper.ZimSearch search = wrapper.ZimSearch(dereference(self.c_archive))
-        search.set_suggestion_mode(False)
-        search.set_query(query.encode('UTF-8'))
-        search.set_range(start, end)
-
-        cdef wrapper.search_iterator it = search.begin()
-        while it != search.end():
-            yield it.get_path().decode('UTF-8')
-            preincrement(it)
+        search = self._get_searcher().search(Query().set_query(query))
+        yield from search.get_results(start, max(end - start, 0))
 
     def get_estimated_search_results_count(self, query: str) -> int:
         """ Estimated number of search results for a query -> int
@@ -667,12 +2032,7 @@ cdef class PyArchive:
             -------
             int
                 Estimated number of search results """
-        cdef wrapper.ZimSearch search = wrapper.ZimSearch(dereference(self.c_archive))
-        search.set_suggestion_mode(False)
-        search.set_query(query.encode('UTF-8'))
-        search.set_range(0, self.entry_count)
-
-        return search.get_matches_estimated()
+        return self._get_searcher().search(Query().set_query(query)).get_estimated_matches()
 
     def get_estimated_suggestions_results_count(self, query: str) -> int:
         """ Estimated number of suggestions for a query -> int
@@ -685,12 +2045,419 @@ cdef class PyArchive:
             -------
             int
                 Estimated number of article suggestions """
-        cdef wrapper.ZimSearch search = wrapper.ZimSearch(dereference(self.c_archive))
-        search.set_suggestion_mode(True)
-        search.set_query(query.encode('UTF-8'))
-        search.set_range(0, self.entry_count)
+        return self._get_searcher().suggest(Query().set_query(query)).get_estimated_matches()
 
-        return search.get_matches_estimated()
+    cdef _get_searcher(self):
+        # created on first use, shared by search/suggest methods
+        if self._searcher is None:
+            searcher = Searcher(self)
+            # no reference back to self (cycle): path-only results don't need it
+            (<Searcher>searcher)._archives = (None,)
+            self._searcher = searcher
+        return self._searcher
 
     def __repr__(self) -> str:
         return f"{self.__class__.__name__}(filename={self.filename})"
+
+
+#########################
+#        Checker        #
+#########################
+
+_check_status_names = {
+    wrapper.CHECK_NOT_STARTED: "not_started",
+    wrapper.CHECK_RUNNING: "running",
+    wrapper.CHECK_VALID: "valid",
+    wrapper.CHECK_INVALID: "invalid",
+    wrapper.CHECK_NO_CHECKSUM: "no_checksum",
+    wrapper.CHECK_CANCELLED: "cancelled",
+    wrapper.CHECK_FAILED: "failed",
+}
+
+
+cdef class Checker:
+    """ Checksum verification of an Archive, on native threads
+
+        File (or parts) reading and MD5 hashing are pipelined, without the
+        GIL. Progress can be polled and verification cancelled.
+
+        Usage:
+
+        checker = Checker(archive)
+        checker.start()
+        while not checker.wait(1):
+            print("{}/{}".format(*checker.progress))
+        print(checker.result) """
+
+    cdef unique_ptr[wrapper.ZimChecker] c_checker
+
+    def __init__(self, PyArchive archive not None):
+        cdef vector[string] parts
+        for part in archive_parts(archive.filename):
+            parts.push_back(str(part).encode('UTF-8'))
+        self.c_checker.reset(new wrapper.ZimChecker(parts))
+
+    def start(self) -> Checker:
+        self.c_checker.get().start()
+        return self
+
+    def cancel(self):
+        """ stops verification ; `result` then raises RuntimeError """
+        self.c_checker.get().cancel()
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        """ Wait for the end of verification, up to timeout seconds -> bool
+
+            Returns whether verification has ended """
+        cdef double _timeout = -1 if timeout is None else timeout
+        cdef bint ended
+        with nogil:
+            ended = self.c_checker.get().wait(_timeout)
+        return ended
+
+    @property
+    def progress(self) -> Tuple[int, int]:
+        """ (processed, total) bytes ; total is 0 until file header is read """
+        return (self.c_checker.get().getProcessed(), self.c_checker.get().getTotal())
+
+    @property
+    def done(self) -> bool:
+        status = self.c_checker.get().getStatus()
+        return status != wrapper.CHECK_NOT_STARTED and status != wrapper.CHECK_RUNNING
+
+    @property
+    def status(self) -> str:
+        """ not_started, running, valid, invalid, no_checksum, cancelled or failed """
+        return _check_status_names[self.c_checker.get().getStatus()]
+
+    @property
+    def result(self) -> bool:
+        """ whether Archive has a checksum and file verifies it (see `status`)
+
+            Raises
+            ------
+                RuntimeError
+                    If not ended, cancelled or if the file can't be read """
+        status = self.c_checker.get().getStatus()
+        if status == wrapper.CHECK_VALID:
+            return True
+        if status == wrapper.CHECK_INVALID or status == wrapper.CHECK_NO_CHECKSUM:
+            return False
+        if status == wrapper.CHECK_CANCELLED:
+            raise RuntimeError("Check cancelled")
+        if status == wrapper.CHECK_FAILED:
+            raise RuntimeError(self.c_checker.get().getError().decode('UTF-8', 'replace'))
+        raise RuntimeError("Check not ended")
+
+
+def archive_parts(filename: pathlib.Path) -> List[pathlib.Path]:
+    """ File(s) of an archive: itself or its parts (.zimaa, .zimab...) """
+    filename = pathlib.Path(filename)
+    if filename.exists():
+        return [filename]
+    # same lookup as libzim: zimaa, zimab... zimba, zimbb...
+    parts = []
+    for first in "abcdefghijklmnopqrstuvwxyz":
+        for second in "abcdefghijklmnopqrstuvwxyz":
+            part = filename.with_name(f"{filename.name}{first}{second}")
+            if not part.exists():
+                break
+            parts.append(part)
+    return parts or [filename]
+
+
+#########################
+#     Header Reader     #
+#########################
+
+# entry_count is the number of all dirents (including metadata, indexes...)
+ArchiveHeader = collections.namedtuple(
+    "ArchiveHeader", [
+        "filename", "uuid", "major_version", "minor_version", "entry_count",
+        "cluster_count", "filesize", "has_main_entry", "has_checksum",
+        "has_fulltext_index", "metadata_keys", "metadata", "error"])
+
+
+def read_headers(filenames: Iterable[pathlib.Path], metadata: Iterable[str] = (),
+                 int threads=0) -> List[ArchiveHeader]:
+    """ Properties of many archives, without opening them -> List[ArchiveHeader]
+
+        Reads the header and a few dirents of each file, on native threads
+        and without the GIL: much faster than opening `Archive`s to scan a
+        library. Errors are reported per file (`error`, other fields are
+        then empty).
+
+        Parameters
+        ----------
+        filenames : Iterable[pathlib.Path]
+            ZIM files (or first name of split ones, without `aa`)
+        metadata : Iterable[str]
+            Names of metadata to read values of (ie. `Title`) into
+            `metadata` (bytes by name). Values being compressed, files
+            are then opened with libzim as well
+        threads : int
+            Number of threads (default 0: one per core)
+        Returns
+        -------
+        List[ArchiveHeader]
+            One per filename, in order """
+    if threads < 0:
+        raise ValueError("threads must be positive (or 0 for default)")
+    filenames = [pathlib.Path(filename) for filename in filenames]
+    cdef vector[vector[string]] archives = [
+        [str(part).encode('UTF-8') for part in archive_parts(filename)]
+        for filename in filenames]
+    cdef vector[string] _metadata = [name.encode('UTF-8') for name in metadata]
+    cdef vector[wrapper.ZimHeaderInfo] infos
+    with nogil:
+        infos = wrapper.readZimHeaders(archives, _metadata, threads)
+
+    cdef wrapper.ZimHeaderInfo* info
+    cdef size_t index
+    cdef size_t pos
+    headers = []
+    for index in range(infos.size()):
+        info = &infos[index]
+        if not info.error.empty():
+            headers.append(ArchiveHeader(
+                filenames[index], None, 0, 0, 0, 0, 0, False, False, False, [], {},
+                info.error.decode('UTF-8', 'replace')))
+            continue
+        values = {}
+        for pos in range(info.metadata.size()):
+            values[info.metadata[pos].first.decode('UTF-8', 'replace')] = bytes(
+                info.metadata[pos].second)
+        headers.append(ArchiveHeader(
+            filename=filenames[index],
+            uuid=UUID(bytes=bytes(info.uuid)),
+            major_version=info.majorVersion,
+            minor_version=info.minorVersion,
+            entry_count=info.entryCount,
+            cluster_count=info.clusterCount,
+            filesize=info.size,
+            has_main_entry=info.hasMainEntry,
+            has_checksum=info.hasChecksum,
+            has_fulltext_index=info.hasFulltextIndex,
+            metadata_keys=[
+                info.metadataKeys[pos].decode('UTF-8', 'replace')
+                for pos in range(info.metadataKeys.size())],
+            metadata=values,
+            error=None))
+    return headers
+
+
+def read_header(filename: pathlib.Path, metadata: Iterable[str] = ()) -> ArchiveHeader:
+    """ Properties of an archive, without opening it -> ArchiveHeader
+
+        See `read_headers()`.
+
+        Raises
+        ------
+            RuntimeError
+                If the file can't be read or is not a ZIM file """
+    header = read_headers([filename], metadata, 1)[0]
+    if header.error is not None:
+        raise RuntimeError(header.error)
+    return header
+
+
+#########################
+#        Search         #
+#########################
+
+SearchRecord = collections.namedtuple(
+    "SearchRecord", ["path", "title", "score", "snippet", "archive"])
+
+
+cdef class Query:
+    """ A query to run with a `Searcher` """
+
+    cdef str _query
+
+    def __init__(self):
+        self._query = ""
+
+    def set_query(self, str query not None) -> Query:
+        self._query = query
+        return self
+
+    @property
+    def query(self) -> str:
+        return self._query
+
+    def __repr__(self) -> str:
+        return f"{self.__class__.__name__}(query={self._query!r})"
+
+
+cdef class SearchResultSet:
+    """ A page of results of a `Search`: iterable of entry paths """
+
+    cdef list _paths
+    cdef list _titles
+    cdef list _archives
+
+    @staticmethod
+    cdef from_results(vector[wrapper.ZimSearchResult]& results, tuple archives):
+        cdef SearchResultSet result_set = SearchResultSet.__new__(SearchResultSet)
+        result_set._paths = [result.path.decode('UTF-8') for result in results]
+        result_set._titles = [result.title.decode('UTF-8') for result in results]
+        result_set._archives = [archives[result.archiveIndex] for result in results]
+        return result_set
+
+    @property
+    def paths(self) -> List[str]:
+        return list(self._paths)
+
+    @property
+    def titles(self) -> List[str]:
+        return list(self._titles)
+
+    @property
+    def archives(self) -> List[PyArchive]:
+        """ Archive of each result """
+        return list(self._archives)
+
+    def __iter__(self):
+        return iter(self._paths)
+
+    def __len__(self) -> int:
+        return len(self._paths)
+
+    def __getitem__(self, index):
+        return self._paths[index]
+
+
+cdef class Search:
+    """ A query run on the archives of a `Searcher`
+
+        Results are kept between calls, so paging through results or getting
+        the estimate after results does not run the query again.
+        Can be shared between threads. """
+
+    cdef shared_ptr[wrapper.ZimSearchResultSet] c_results
+    cdef tuple _archives
+
+    def get_estimated_matches(self) -> int:
+        """ Estimated number of results """
+        cdef int estimated
+        with nogil:
+            estimated = self.c_results.get().getEstimatedMatches()
+        return estimated
+
+    def get_results(self, int start, int count) -> SearchResultSet:
+        """ Results [start, start + count) ; less at end of results """
+        if start < 0 or count < 0:
+            raise ValueError("start and count must be positive")
+        cdef vector[wrapper.ZimSearchResult] results
+        with nogil:
+            results = self.c_results.get().getResults(start, count, False)
+        return SearchResultSet.from_results(results, self._archives)
+
+    def get_records(self, int start, int count, bint snippets=False) -> List[SearchRecord]:
+        """ Results [start, start + count) as (path, title, score, snippet, archive) records
+
+            The whole page is fetched at once without the GIL.
+
+            Parameters
+            ----------
+            start : int
+                index of first result
+            count : int
+                number of results
+            snippets : bool
+                whether to generate snippets (reads content). snippet is None
+                if not requested
+            Returns
+            -------
+            List[SearchRecord]
+                path, title, score (relevance, percent), snippet and `Archive`
+                of results """
+        if start < 0 or count < 0:
+            raise ValueError("start and count must be positive")
+        cdef vector[wrapper.ZimSearchResult] results
+        with nogil:
+            results = self.c_results.get().getResults(start, count, snippets)
+        return [
+            SearchRecord(
+                result.path.decode('UTF-8'),
+                result.title.decode('UTF-8'),
+                result.score,
+                result.snippet.decode('UTF-8') if result.hasSnippet else None,
+                self._archives[result.archiveIndex])
+            for result in results]
+
+
+cdef class Searcher:
+    """ Runs queries on one or several archives
+
+        Searches of recent queries are kept, so running a query again reuses
+        its results. Can be shared between threads.
+
+        Usage:
+
+        searcher = Searcher(archive)
+        search = searcher.search(Query().set_query("lorem"))
+        print(search.get_estimated_matches())
+        print(list(search.get_results(0, 10))) """
+
+    cdef vector[wrapper.ZimArchive] c_archives
+    cdef tuple _archives
+    cdef object _searches
+    cdef object _lock
+    cdef int _cache_size
+
+    def __init__(self, archives, int cache_size=16):
+        """ Parameters
+            ----------
+            archives : Union[Archive, Iterable[Archive]]
+                archive(s) to search in. Results of several archives are
+                merged and ranked together (archives without the needed
+                index are skipped)
+            cache_size : int
+                number of recent searches to keep (default 16) """
+        if isinstance(archives, PyArchive):
+            archives = [archives]
+        self._archives = tuple(archives)
+        if not self._archives:
+            raise ValueError("Searcher needs at least one archive")
+        for archive in self._archives:
+            if not isinstance(archive, PyArchive):
+                raise TypeError(f"Not an Archive: {archive!r}")
+            self.c_archives.push_back(dereference((<PyArchive>archive).c_archive))
+        self._searches = collections.OrderedDict()
+        self._lock = threading.Lock()
+        self._cache_size = cache_size
+
+    cdef Search _get_search(self, str query, bint suggestion):
+        key = (query, suggestion)
+        with self._lock:
+            search = self._searches.get(key)
+            if search is not None:
+                self._searches.move_to_end(key)
+                return search
+
+        cdef string _query = query.encode('UTF-8')
+        search = Search.__new__(Search)
+        (<Search>search)._archives = self._archives
+        (<Search>search).c_results = make_shared[wrapper.ZimSearchResultSet](
+            self.c_archives, _query, suggestion)
+
+        with self._lock:
+            # another thread may have created it meanwhile: keep first one
+            search = self._searches.setdefault(key, search)
+            self._searches.move_to_end(key)
+            while len(self._searches) > self._cache_size:
+                self._searches.popitem(last=False)
+        return search
+
+    @property
+    def archives(self) -> List[PyArchive]:
+        return list(self._archives)
+
+    def search(self, Query query not None) -> Search:
+        """ Full-text search of query """
+        return self._get_search(query.query, False)
+
+    def suggest(self, Query query not None) -> Search:
+        """ Title suggestions for query """
+        return self._get_search(query.query, True)
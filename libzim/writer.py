@@ -1,6 +1,7 @@
 """ libzim writer module
     - Creator to create ZIM files
     - Item to store ZIM articles metadata
+    - StaticItem, a native Item with all its data set at creation
     - ContentProvider to store an Item's content
     - Blob to store actual content
 
@@ -37,9 +38,11 @@ from typing import Union
 
 from .wrapper import Creator as _Creator, Compression
 from .wrapper import WritingBlob as Blob
+from .wrapper import StaticItem
 
 __all__ = [
     "Item",
+    "StaticItem",
     "Blob",
     "Creator",
     "ContentProvider",
@@ -79,18 +82,28 @@ class ContentProvider:
 
 
 class StringProvider(ContentProvider):
+    """Content from a str (UTF-8 encoded) or any bytes-like object
+
+    bytes-like objects (bytes, bytearray, memoryview, mmap...) are not copied"""
+
     def __init__(self, content):
         super().__init__()
         self.content = content.encode("UTF-8") if isinstance(content, str) else content
+        self.size = memoryview(self.content).nbytes
 
     def get_size(self):
-        return len(self.content)
+        return self.size
 
     def gen_blob(self):
         yield Blob(self.content)
 
 
 class FileProvider(ContentProvider):
+    """Content of a file
+
+    When used as is (not subclassed) by an Item passed to the Creator, the file
+    is read natively (mmap/pread) and `gen_blob()` is not called."""
+
     def __init__(self, filepath):
         super().__init__()
         self.filepath = filepath
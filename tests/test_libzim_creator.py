@@ -1,11 +1,13 @@
 #!/usr/bin/env python
 
 import sys
+import array
 import base64
 import pathlib
 import datetime
 import itertools
 import subprocess
+import weakref
 
 
 import pytest
@@ -123,6 +125,7 @@ def test_imports():
     assert libzim.writer.Compression  # noqa
     assert libzim.writer.Blob  # noqa
     assert libzim.writer.Item  # noqa
+    assert libzim.writer.StaticItem  # noqa
     assert libzim.writer.ContentProvider  # noqa
     assert libzim.writer.FileProvider  # noqa
     assert libzim.writer.StringProvider  # noqa
@@ -260,6 +263,7 @@ def test_creator_combine_config(fpath, lipsum_item):
         ("minclustersize", (1024,)),
         ("indexing", (True, "eng")),
         ("nbworkers", (2,)),
+        ("itemqueue", (8,)),
     ],
 )
 def test_creator_config_poststart(fpath, name, args):
@@ -371,6 +375,50 @@ def test_creator_additem(fpath, lipsum_item):
             c.add_item(mimetype="text/html")
 
 
+@pytest.mark.parametrize("queue_size", [0, 1, 8])
+def test_creator_additems(fpath, lipsum, queue_size):
+    def items():
+        for index in range(0, 300):
+            yield StaticItem(path=f"item{index}", content=lipsum, mimetype="text/html")
+        yield libzim.writer.StaticItem(HOME_PATH, "Home", "text/html", content=lipsum)
+
+    with Creator(fpath).config_itemqueue(queue_size) as c:
+        c.add_items(items())
+        c.add_items([])
+        # queued items must be in before redirections and metadata
+        c.add_redirection("home", "Home", HOME_PATH)
+        c.add_metadata("Name", b"name")
+        c.add_item(StaticItem(path="last", content=lipsum, mimetype="text/html"))
+
+    zim = Archive(fpath)
+    assert zim.entry_count == 303
+    assert zim.get_metadata("Name") == b"name"
+    assert zim.get_entry_by_path("home").get_redirect_entry().path == HOME_PATH
+    for path in ("item0", "item299", "last", HOME_PATH):
+        assert bytes(zim.get_entry_by_path(path).get_item().content) == (
+            lipsum.encode("UTF-8")
+        )
+
+
+def test_creator_additems_errors(fpath, lipsum_item):
+    with pytest.raises(RuntimeError, match="not started"):
+        Creator(fpath).add_items([lipsum_item])
+    with pytest.raises(ValueError):
+        Creator(fpath).config_itemqueue(-1)
+
+    with Creator(fpath) as c:
+        with pytest.raises(TypeError):
+            c.add_items([None])
+        with pytest.raises(RuntimeError):
+            c.add_items(["hello"])
+
+    # with a queue, error is reported later (here, on exit)
+    with pytest.raises(RuntimeError):
+        with Creator(fpath).config_itemqueue(4) as c:
+            c.add_items([lipsum_item, "hello"])
+    assert Archive(fpath).entry_count == 1
+
+
 def test_creator_metadata(fpath, lipsum_item):
     metadata = {
         # kiwix-mandatory
@@ -497,6 +545,47 @@ def test_fileprovider(fpath, lipsum):
         b = cp.feed()
 
 
+def test_fileprovider_native(fpath, lipsum, monkeypatch):
+    """plain FileProviders are read natively, subclasses through gen_blob"""
+    lipsum_fpath = fpath.with_name("lipsum.html")
+    with open(lipsum_fpath, "w") as fh:
+        for _ in range(0, 1000):
+            fh.write(lipsum)
+
+    def no_gen_blob(self):
+        raise RuntimeError("gen_blob should not be called")
+
+    monkeypatch.setattr(FileProvider, "gen_blob", no_gen_blob)
+    with Creator(fpath) as c:
+        c.add_item(StaticItem(path=HOME_PATH, filepath=lipsum_fpath))
+    monkeypatch.undo()
+
+    zim = Archive(fpath)
+    assert bytes(zim.get_entry_by_path(HOME_PATH).get_item().content) == (
+        lipsum_fpath.read_bytes()
+    )
+
+    calls = []
+
+    class AFileProvider(FileProvider):
+        def gen_blob(self):
+            calls.append(self.filepath)
+            yield from super().gen_blob()
+
+    class AnItem(StaticItem):
+        def get_contentprovider(self):
+            return AFileProvider(filepath=self.filepath)
+
+    fpath.unlink()
+    with Creator(fpath) as c:
+        c.add_item(AnItem(path=HOME_PATH, filepath=lipsum_fpath))
+    assert calls == [lipsum_fpath]
+    zim = Archive(fpath)
+    assert bytes(zim.get_entry_by_path(HOME_PATH).get_item().content) == (
+        lipsum_fpath.read_bytes()
+    )
+
+
 def test_stringprovider(fpath, lipsum):
     item = StaticItem(path=HOME_PATH, content=lipsum, mimetype="text/html")
     assert HOME_PATH in str(item)
@@ -518,6 +607,95 @@ def test_stringprovider(fpath, lipsum):
         b = cp.feed()
 
 
+@pytest.mark.parametrize("nb_workers", [1, 4])
+def test_native_staticitem(fpath, lipsum, favicon_data, nb_workers):
+    lipsum_fpath = fpath.with_name("lipsum.html")
+    with open(lipsum_fpath, "w") as fh:
+        for _ in range(0, 10):
+            fh.write(lipsum)
+
+    items = [
+        libzim.writer.StaticItem(HOME_PATH, "Home", "text/html", content=lipsum),
+        libzim.writer.StaticItem("favicon", mimetype="image/png", content=favicon_data),
+        libzim.writer.StaticItem("file", "", "text/html", filepath=lipsum_fpath),
+        libzim.writer.StaticItem("empty", mimetype="text/plain"),
+    ]
+    assert items[0].get_path() == HOME_PATH
+    assert items[0].get_title() == "Home"
+    assert items[0].get_mimetype() == "text/html"
+    assert items[0].get_size() == len(lipsum.encode("UTF-8"))
+    assert items[2].get_size() == lipsum_fpath.stat().st_size
+    assert HOME_PATH in str(items[0])
+
+    with Creator(fpath).config_nbworkers(nb_workers) as c:
+        for item in items:
+            c.add_item(item)
+        # can be mixed with python items
+        c.add_item(StaticItem(path="python", content=lipsum, mimetype="text/html"))
+    del items
+
+    zim = Archive(fpath)
+    assert zim.entry_count == 5
+    assert bytes(zim.get_entry_by_path(HOME_PATH).get_item().content) == (
+        lipsum.encode("UTF-8")
+    )
+    assert zim.get_entry_by_path(HOME_PATH).title == "Home"
+    assert bytes(zim.get_entry_by_path("favicon").get_item().content) == favicon_data
+    assert zim.get_entry_by_path("file").get_item().mimetype == "text/html"
+    assert bytes(zim.get_entry_by_path("file").get_item().content) == (
+        lipsum_fpath.read_bytes()
+    )
+    assert zim.get_entry_by_path("empty").get_item().size == 0
+    assert bytes(zim.get_entry_by_path("python").get_item().content) == (
+        lipsum.encode("UTF-8")
+    )
+
+
+def test_native_staticitem_errors(fpath):
+    with pytest.raises(IOError):
+        libzim.writer.StaticItem("missing", filepath=fpath.with_name("missing"))
+    with pytest.raises(ValueError):
+        libzim.writer.StaticItem("both", content="a", filepath=fpath)
+    with pytest.raises(TypeError):
+        libzim.writer.StaticItem(None)
+
+
+@pytest.mark.parametrize(
+    "content",
+    [
+        b"some bytes",
+        bytearray(b"some bytes"),
+        memoryview(b"--some bytes--")[2:-2],
+        array.array("B", b"some bytes"),
+        "some bytes",
+    ],
+)
+def test_blob_buffers(fpath, content):
+    blob = Blob(content)
+    assert blob.size() == len(b"some bytes")
+
+    item = StaticItem(path=HOME_PATH, content=content, mimetype="text/plain")
+    with Creator(fpath) as c:
+        c.add_item(item)
+    zim = Archive(fpath)
+    assert bytes(zim.get_entry_by_path(HOME_PATH).get_item().content) == (
+        b"some bytes"
+    )
+
+
+def test_blob_buffer_locked():
+    content = bytearray(b"some bytes")
+    blob = Blob(content)
+    # content is used as is, so can't be resized while blob exists
+    with pytest.raises(BufferError):
+        content.extend(b"more bytes")
+    del blob
+    content.extend(b"more bytes")
+
+    with pytest.raises(TypeError):
+        Blob(None)
+
+
 def test_item_contentprovider_none(fpath):
     class AnItem:
         def get_path(self):
@@ -589,6 +767,150 @@ def test_reimpfeed(fpath):
     assert cp.feed().size() == 1
 
 
+def test_virtualmethods_lookup_once(fpath):
+    """bound methods are looked up once per item/provider, not on every call"""
+    lookups = []
+
+    class AContentProvider:
+        def __init__(self):
+            self.chunks = [b"a" * 10] * 100
+
+        def __getattribute__(self, name):
+            lookups.append(name)
+            return super().__getattribute__(name)
+
+        def get_size(self):
+            return 1000
+
+        def feed(self):
+            chunks = super().__getattribute__("chunks")
+            self._blob = Blob(chunks.pop() if chunks else b"")
+            return self._blob
+
+    class AnItem:
+        def get_path(self):
+            return "-"
+
+        def get_title(self):
+            return ""
+
+        def get_mimetype(self):
+            return "text/plain"
+
+        def get_contentprovider(self):
+            return AContentProvider()
+
+    with Creator(fpath) as c:
+        c.add_item(AnItem())
+
+    assert lookups.count("feed") == 1
+    assert lookups.count("get_size") == 1
+    assert bytes(Archive(fpath).get_entry_by_path("-").get_item().content) == (
+        b"a" * 1000
+    )
+
+
+@pytest.mark.parametrize("nb_workers", [1, 4])
+def test_item_references_released(fpath, lipsum, nb_workers):
+    """python items are released, even when destroyed by libzim threads"""
+    items = [
+        StaticItem(path=f"item{index}", content=lipsum, mimetype="text/html")
+        for index in range(0, 50)
+    ]
+    refs = [weakref.ref(item) for item in items]
+    with Creator(fpath).config_nbworkers(nb_workers) as c:
+        c.add_items(items)
+    del items
+    assert [ref() for ref in refs] == [None] * len(refs)
+    assert Archive(fpath).entry_count == 50
+
+
+@pytest.mark.parametrize("queue_size", [0, 4])
+def test_creator_stats(fpath, lipsum, queue_size):
+    creator = Creator(fpath).config_compression(libzim.writer.Compression.lzma)
+    stats = creator.stats
+    assert stats["items_added"] == 0
+    assert stats["elapsed"] == 0
+    assert stats["finish_time"] is None
+    assert stats["compression"] == "lzma"
+
+    with creator.config_itemqueue(queue_size) as c:
+        c.add_items(
+            StaticItem(path=f"item{index}", content=lipsum, mimetype="text/html")
+            for index in range(0, 20)
+        )
+        c.add_item(
+            libzim.writer.StaticItem("native", "", "text/html", content=lipsum)
+        )
+        stats = c.stats
+        assert 0 <= stats["item_queue_depth"] <= queue_size
+        assert stats["finish_time"] is None
+
+    stats = creator.stats
+    assert stats["items_added"] == 21
+    assert stats["item_queue_depth"] == 0
+    assert stats["elapsed"] > 0
+    assert stats["items_per_second"] > 0
+    assert 0 <= stats["finish_time"] <= stats["elapsed"]
+    # each python item is called back for (at least) its content provider
+    assert stats["callback_calls"] >= 20
+    assert stats["callback_time"] >= stats["gil_wait_time"] >= 0
+    assert stats["bytes_in"] == 21 * len(lipsum.encode("UTF-8"))
+    assert stats["bytes_out"] == fpath.stat().st_size
+    # stats are frozen once finished
+    assert creator.stats["elapsed"] == stats["elapsed"]
+
+
+@pytest.mark.parametrize("queue_size", [0, 4])
+def test_creator_dedup(fpath, lipsum, queue_size):
+    logo = b"\x89PNG fake logo" * 64
+    with Creator(fpath).config_dedup(True).config_itemqueue(queue_size) as c:
+        for index in range(0, 5):
+            c.add_item(
+                StaticItem(path=f"logo{index}", content=logo, mimetype="image/png")
+            )
+        # same content, other mimetype: not a duplicate
+        c.add_item(StaticItem(path="logo.txt", content=logo, mimetype="text/plain"))
+        c.add_item(
+            libzim.writer.StaticItem("native", "", "image/png", content=logo)
+        )
+        c.add_item(StaticItem(path="article", content=lipsum, mimetype="text/html"))
+
+    stats = c.stats
+    assert stats["items_added"] == 8
+    assert stats["dedup_items"] == 8
+    assert stats["dedup_duplicates"] == 5
+    assert stats["dedup_bytes_saved"] == 5 * len(logo)
+
+    zim = Archive(fpath)
+    assert not zim.get_entry_by_path("logo0").is_redirect
+    assert not zim.get_entry_by_path("logo.txt").is_redirect
+    for path in ("logo1", "logo4", "native"):
+        entry = zim.get_entry_by_path(path)
+        assert entry.is_redirect
+        assert entry.get_redirect_entry().path == "logo0"
+        assert bytes(entry.get_item().content) == logo
+    assert bytes(zim.get_entry_by_path("article").get_item().content) == lipsum.encode(
+        "UTF-8"
+    )
+
+
+def test_creator_dedup_max_size(fpath, lipsum):
+    content = lipsum.encode("UTF-8")
+    with Creator(fpath).config_dedup(True, max_size=len(content) - 1) as c:
+        for index in range(0, 3):
+            c.add_item(StaticItem(path=f"item{index}", content=lipsum))
+        with pytest.raises(RuntimeError, match="started"):
+            c.config_dedup(False)
+
+    stats = c.stats
+    assert stats["dedup_items"] == 0
+    assert stats["dedup_duplicates"] == 0
+    assert stats["bytes_in"] == 3 * len(content)
+    zim = Archive(fpath)
+    assert not any(zim.get_entry_by_path(f"item{i}").is_redirect for i in range(3))
+
+
 def test_virtualmethods_int_exc(fpath):
     class AContentProvider:
         def get_size(self):
@@ -1,15 +1,32 @@
 #!/usr/bin/env python
 
 import os
+import asyncio
 import gc
+import hashlib
+import io
+import itertools
 import uuid
+import weakref
 import pathlib
+import shutil
+import socket
+import threading
+import time
 from urllib.request import urlretrieve
 
 import pytest
 
 import libzim.writer
-from libzim.reader import Archive
+from libzim.reader import (
+    Archive,
+    ArchiveHeader,
+    Checker,
+    ReaderStats,
+    read_header,
+    read_headers,
+)
+from libzim.search import Query, Searcher, SearchRecord, SearchResultSet
 
 
 # expected data for tests ZIMs (see `all_zims`)
@@ -216,6 +233,31 @@ def all_zims(tmpdir_factory):
     return pathlib.Path(temp_dir)
 
 
+# number of items with "lorem" in `indexed_zim`
+NB_LOREM = 60
+
+
+@pytest.fixture(scope="module")
+def indexed_zim(tmpdir_factory):
+    """ZIM with full-text and title indexes, NB_LOREM items matching lorem"""
+    fpath = pathlib.Path(tmpdir_factory.mktemp("indexed") / "indexed.zim")
+    with libzim.writer.Creator(fpath).config_indexing(True, "eng") as c:
+        for index in range(0, NB_LOREM):
+            content = f"<html><head><title>Lorem {index}</title></head><body>"
+            content += "lorem ipsum " * (index + 1) + "</body></html>"
+            c.add_item(
+                libzim.writer.StaticItem(
+                    f"lorem{index}", f"Lorem {index}", "text/html", content
+                )
+            )
+        c.add_item(
+            libzim.writer.StaticItem(
+                "other", "Other", "text/html", "<html><body>dolor</body></html>"
+            )
+        )
+    return fpath
+
+
 def test_open_badfile(tmpdir):
     fpath = tmpdir / "not-exist.zim"
     with pytest.raises(RuntimeError):
@@ -257,6 +299,35 @@ def test_content_ref_keep(all_zims):
     )
 
 
+def test_threaded_reads(all_zims):
+    """Read all entries of a single Archive from several threads at once.
+    Reader calls release the GIL so this really runs concurrently in libzim"""
+    archive = Archive(all_zims / "zimfile.zim")
+    expected = {}
+    for i in range(0, archive.entry_count):
+        entry = archive._get_entry_by_id(i)
+        if not entry.is_redirect:
+            expected[entry.path] = bytes(entry.get_item().content)
+
+    errors = []
+
+    def read_all():
+        try:
+            for path, content in expected.items():
+                item = archive.get_entry_by_path(path).get_item()
+                assert item.size == len(content)
+                assert bytes(item.content) == content
+        except Exception as exc:  # noqa
+            errors.append(exc)
+
+    threads = [threading.Thread(target=read_all) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert not errors
+
+
 @pytest.mark.parametrize(
     *parametrize_for(["filename", "filesize", "new_ns", "mutlipart", "zim_uuid"])
 )
@@ -295,6 +366,23 @@ def test_reader_metadata(
     assert zim.metadata_keys == metadata_keys
     if test_metadata:
         assert zim.get_metadata(test_metadata).decode("UTF-8") == test_metadata_value
+        item = zim.get_metadata_item(test_metadata)
+        assert bytes(item.content).decode("UTF-8") == test_metadata_value
+        view = zim.metadata_snapshot([test_metadata, "missing"])[test_metadata]
+        assert str(view, "UTF-8") == test_metadata_value
+    with pytest.raises(KeyError):
+        zim.get_metadata_item("missing")
+
+    snapshot = zim.metadata_snapshot()
+    assert sorted(snapshot) == sorted(metadata_keys)
+    for key, view in snapshot.items():
+        assert isinstance(view, memoryview)
+        assert bytes(view) == zim.get_metadata(key)
+    assert zim.metadata_snapshot([]) == {}
+    assert zim.metadata_snapshot(["missing"]) == {}
+    # cached keys are not shared with callers
+    zim.metadata_keys.append("other")
+    assert zim.metadata_keys == metadata_keys
 
 
 @pytest.mark.parametrize(
@@ -349,6 +437,73 @@ def test_reader_checksum(all_zims, filename, has_checksum, is_valid):
     assert zim.check() is is_valid
 
 
+@pytest.mark.parametrize(*parametrize_for(["filename", "has_checksum", "is_valid"]))
+def test_reader_checker(all_zims, filename, has_checksum, is_valid):
+    zim = Archive(all_zims / filename)
+
+    calls = []
+    assert zim.check(progress=lambda *args: calls.append(args), interval=0.001) is (
+        is_valid
+    )
+    assert calls
+    if has_checksum:
+        # last call reports everything hashed
+        assert calls[-1] == (calls[-1][1], calls[-1][1])
+        assert calls[-1][1] < zim.filesize
+
+    checker = Checker(zim)
+    assert not checker.done
+    assert checker.status == "not_started"
+    with pytest.raises(RuntimeError, match="not ended"):
+        checker.result
+    checker.start()
+    assert checker.wait() is True
+    assert checker.done
+    assert checker.result is is_valid
+    if not has_checksum:
+        assert checker.status == "no_checksum"
+    else:
+        assert checker.status == ("valid" if is_valid else "invalid")
+
+
+def test_reader_checker_multipart(all_zims, tmpdir):
+    source = all_zims / "example.zim"
+    content = source.read_bytes()
+    fpath = pathlib.Path(tmpdir / "split.zim")
+    for index, suffix in enumerate(("aa", "ab", "ac")):
+        third = len(content) // 3 + 1
+        fpath.with_name(f"split.zim{suffix}").write_bytes(
+            content[index * third : (index + 1) * third]
+        )
+    split = Archive(fpath)
+    assert split.check(progress=lambda *args: None) is Archive(source).check()
+
+    # alter content (not header nor checksum)
+    fpath.with_name("split.zimab").write_bytes(b"\0" * (len(content) // 3 + 1))
+    checker = Checker(split).start()
+    assert checker.wait(10)
+    assert checker.result is False
+
+
+def test_reader_checker_cancel(all_zims):
+    zim = Archive(all_zims / "example.zim")
+    try:
+        result = zim.check(progress=lambda *args: False, interval=0)
+    except RuntimeError as exc:
+        assert "cancelled" in str(exc)
+    else:
+        # ended before first progress call
+        assert result is zim.check()
+
+    checker = Checker(zim)
+    checker.cancel()
+    checker.start()
+    checker.wait()
+    if zim.has_checksum:
+        with pytest.raises(RuntimeError, match="cancelled"):
+            checker.result
+
+
 @pytest.mark.parametrize(
     *parametrize_for(
         [
@@ -387,6 +542,155 @@ def test_reader_suggest_search(
     assert list(zim.search(search_string)) == search_result
 
 
+@pytest.mark.parametrize(
+    *parametrize_for(
+        ["filename", "suggestion_string", "suggestion_result", "search_string"]
+    )
+)
+def test_reader_searcher(
+    all_zims, filename, suggestion_string, suggestion_result, search_string
+):
+    zim = Archive(all_zims / filename)
+    searcher = Searcher(zim)
+
+    search = searcher.suggest(Query().set_query(suggestion_string))
+    assert list(search.get_results(0, 10)) == suggestion_result
+    assert search.get_estimated_matches() == (
+        zim.get_estimated_suggestions_results_count(suggestion_string)
+    )
+    search = searcher.search(Query().set_query(search_string))
+    assert list(search.get_results(0, 10)) == list(zim.search(search_string))
+
+
+def test_reader_search_pages(indexed_zim):
+    zim = Archive(indexed_zim)
+    searcher = Searcher(zim)
+    query = Query().set_query("lorem")
+    assert query.query == "lorem"
+
+    search = searcher.search(query)
+    # same query reuses same search (and its results)
+    assert searcher.search(Query().set_query("lorem")) is search
+    assert searcher.suggest(query) is not search
+
+    assert search.get_estimated_matches() == NB_LOREM
+    everything = search.get_results(0, NB_LOREM + 10)
+    assert isinstance(everything, SearchResultSet)
+    assert len(everything) == NB_LOREM
+    assert len(set(everything)) == NB_LOREM
+    assert "other" not in everything.paths
+    assert all(title.startswith("Lorem") for title in everything.titles)
+
+    # pages match a single run, in a fresh search as well
+    search = Searcher(zim).search(query)
+    pages = []
+    for start in range(0, NB_LOREM, 7):
+        pages.extend(search.get_results(start, 7))
+    assert pages == list(everything)
+    assert list(search.get_results(NB_LOREM, 10)) == []
+    assert everything[3] == pages[3]
+
+    with pytest.raises(ValueError):
+        search.get_results(-1, 10)
+
+    # legacy API uses the same searches
+    assert list(zim.search("lorem", 5, 15)) == list(everything)[5:15]
+    assert zim.get_estimated_search_results_count("lorem") == NB_LOREM
+
+
+def test_reader_search_records(indexed_zim):
+    search_archive = Archive(indexed_zim)
+    search = Searcher(search_archive).search(Query().set_query("lorem"))
+
+    records = search.get_records(0, 20)
+    assert len(records) == 20
+    assert [record.path for record in records] == list(search.get_results(0, 20))
+    for record in records:
+        assert isinstance(record, SearchRecord)
+        path, title, score, snippet, archive = record
+        assert archive is search_archive
+        assert title == f"Lorem {path[len('lorem'):]}"
+        assert 0 < score <= 100
+        assert snippet is None
+    assert [record.score for record in records] == sorted(
+        [record.score for record in records], reverse=True
+    )
+
+    # snippets, already fetched page or not
+    for start in (10, 40):
+        records = search.get_records(start, 5, snippets=True)
+        assert len(records) == 5
+        assert all("lorem" in record.snippet.lower() for record in records)
+    assert search.get_records(NB_LOREM, 5) == []
+
+    with pytest.raises(ValueError):
+        search.get_records(0, -1)
+
+
+def test_reader_search_multi(all_zims, indexed_zim, tmpdir):
+    # a second indexed ZIM, with less lorem items
+    fpath = pathlib.Path(tmpdir / "other.zim")
+    with libzim.writer.Creator(fpath).config_indexing(True, "eng") as c:
+        for index in range(0, 5):
+            c.add_item(
+                libzim.writer.StaticItem(
+                    f"other{index}",
+                    f"Other {index}",
+                    "text/html",
+                    "<html><body>" + "lorem dolor " * 50 + "</body></html>",
+                )
+            )
+    first, second = Archive(indexed_zim), Archive(fpath)
+    # blank.zim has no full-text index: ignored
+    searcher = Searcher([first, Archive(all_zims / "blank.zim"), second])
+    assert len(searcher.archives) == 3
+
+    search = searcher.search(Query().set_query("lorem"))
+    assert search.get_estimated_matches() == NB_LOREM + 5
+    records = search.get_records(0, NB_LOREM + 5)
+    assert len(records) == NB_LOREM + 5
+    assert {record.archive.filename for record in records} == {
+        first.filename,
+        second.filename,
+    }
+    for record in records:
+        assert record.path.startswith(
+            "lorem" if record.archive is first else "other"
+        )
+    # merged ranking, not one archive after the other
+    scores = [record.score for record in records]
+    assert scores == sorted(scores, reverse=True)
+
+    results = search.get_results(0, 10)
+    assert results.archives == [record.archive for record in records[:10]]
+
+    with pytest.raises(ValueError):
+        Searcher([])
+    with pytest.raises(TypeError):
+        Searcher([first, "second"])
+
+
+def test_reader_search_threads(indexed_zim):
+    search = Searcher(Archive(indexed_zim)).search(Query().set_query("lorem"))
+    results = []
+
+    def worker(start):
+        results.append((start, list(search.get_results(start, 10))))
+
+    threads = [
+        threading.Thread(target=worker, args=(start,))
+        for start in range(0, NB_LOREM, 10)
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    everything = list(search.get_results(0, NB_LOREM))
+    for start, page in results:
+        assert page == everything[start : start + 10]
+
+
 @pytest.mark.parametrize(
     *parametrize_for(
         [
@@ -440,6 +744,122 @@ def test_reader_get_entries(
         assert zim.get_entry_by_title(test_title).path == entry.path
 
 
+@pytest.mark.parametrize(*parametrize_for(["filename", "test_path", "test_size"]))
+def test_reader_ranged_read(all_zims, filename, test_path, test_size):
+    if not test_path:
+        pytest.skip("no test path for this ZIM")
+    item = Archive(all_zims / filename).get_entry_by_path(test_path).get_item()
+    content = bytes(item.content)
+
+    assert bytes(item.read()) == content
+    assert bytes(item.read(0, 10)) == content[:10]
+    assert bytes(item.read(test_size // 2)) == content[test_size // 2 :]
+    assert bytes(item.read(test_size // 2, 5)) == content[test_size // 2 :][:5]
+    assert bytes(item.read(test_size, 10)) == b""
+    assert bytes(item.read(max(test_size - 3, 0), 10)) == content[-3:]
+    with pytest.raises(ValueError):
+        item.read(test_size + 1)
+    with pytest.raises(ValueError):
+        item.read(-1)
+
+    chunks = list(item.iter_content(chunk_size=1000))
+    assert all(chunk.nbytes <= 1000 for chunk in chunks)
+    assert b"".join(bytes(chunk) for chunk in chunks) == content
+
+
+def test_reader_direct_access(tmpdir):
+    content = b"<html><body>" + b"uncompressed " * 1000 + b"</body></html>"
+
+    class AnItem(libzim.writer.Item):
+        def __init__(self, path):
+            super().__init__()
+            self.path = path
+
+        def get_path(self):
+            return self.path
+
+        def get_title(self):
+            return ""
+
+        def get_mimetype(self):
+            return "text/html"
+
+        def get_contentprovider(self):
+            return libzim.writer.StringProvider(content)
+
+    for compression in ("none", "zstd"):
+        fpath = pathlib.Path(tmpdir / f"{compression}.zim")
+        with libzim.writer.Creator(fpath).config_compression(compression) as c:
+            c.add_item(AnItem("home"))
+        item = Archive(fpath).get_entry_by_path("home").get_item()
+        info = item.get_direct_access_information()
+
+        if compression == "zstd":
+            assert info is None
+            continue
+
+        filepath, offset = info
+        assert filepath == fpath
+        with open(filepath, "rb") as fh:
+            fh.seek(offset)
+            assert fh.read(item.size) == content
+
+
+@pytest.mark.parametrize("compression", ["none", "zstd"])
+def test_reader_sendfile(tmpdir, compression):
+    fpath = pathlib.Path(tmpdir / f"{compression}.zim")
+    content = b"<html><body>" + b"sent " * 1000 + b"</body></html>"
+
+    class AnItem(libzim.writer.Item):
+        def get_path(self):
+            return "home"
+
+        def get_title(self):
+            return ""
+
+        def get_mimetype(self):
+            return "text/html"
+
+        def get_contentprovider(self):
+            return libzim.writer.StringProvider(content)
+
+    with libzim.writer.Creator(fpath).config_compression(compression) as c:
+        c.add_item(AnItem())
+    item = Archive(fpath).get_entry_by_path("home").get_item()
+
+    out_path = pathlib.Path(tmpdir / "out.html")
+    with open(out_path, "wb") as fh:
+        assert item.sendfile(fh) == len(content)
+    assert out_path.read_bytes() == content
+
+    with open(out_path, "wb") as fh:
+        assert item.sendfile(fh.fileno(), 12, 10) == 10
+        assert item.sendfile(fh.fileno(), len(content), 10) == 0
+    assert out_path.read_bytes() == content[12:22]
+
+    with pytest.raises(ValueError):
+        item.sendfile(1, -1)
+
+    # non-blocking socket with a full buffer: nothing sent is not end of content
+    sender, receiver = socket.socketpair()
+    with sender, receiver:
+        sender.setblocking(False)
+        try:
+            while True:
+                sender.send(b"x" * 65536)
+        except BlockingIOError:
+            pass
+        with pytest.raises(BlockingIOError):
+            item.sendfile(sender)
+        receiver.setblocking(False)
+        try:
+            while True:
+                receiver.recv(65536)
+        except BlockingIOError:
+            pass
+        assert 0 < item.sendfile(sender) <= len(content)
+
+
 @pytest.mark.parametrize(
     *parametrize_for(["filename", "test_redirect", "test_redirect_to"])
 )
@@ -460,6 +880,38 @@ def test_reader_redirect(all_zims, filename, test_redirect, test_redirect_to):
                 target_entry.get_redirect_entry().get_redirect_entry()
 
 
+@pytest.mark.parametrize(
+    *parametrize_for(["filename", "test_path", "test_redirect", "test_redirect_to"])
+)
+def test_reader_batch_lookup(
+    all_zims, filename, test_path, test_redirect, test_redirect_to
+):
+    zim = Archive(all_zims / filename)
+
+    paths = [path for path in (test_path, test_redirect) if path] + ["___missing"]
+    indexes, redirects, missing = zim.get_entries_by_path(paths)
+    assert len(indexes) == len(redirects) == len(missing) == len(paths)
+    for path, index, redirect, miss in zip(paths, indexes, redirects, missing):
+        if path == "___missing":
+            assert miss
+            continue
+        assert not miss
+        entry = zim.get_entry_by_path(path)
+        assert index == entry._index
+        assert bool(redirect) is entry.is_redirect
+
+    indexes, redirects, missing = zim.get_entries_by_index(
+        list(range(zim.entry_count)) + [zim.entry_count]
+    )
+    assert list(indexes[:-1]) == list(range(zim.entry_count))
+    assert not any(missing[:-1])
+    assert missing[-1]
+    for index in range(zim.entry_count):
+        assert bool(redirects[index]) is zim._get_entry_by_id(index).is_redirect
+
+    assert [len(res) for res in zim.get_entries_by_path([])] == [0, 0, 0]
+
+
 @pytest.mark.parametrize(*parametrize_for(["filename"]))
 def test_reader_by_id(all_zims, filename):
     zim = Archive(all_zims / filename)
@@ -470,6 +922,35 @@ def test_reader_by_id(all_zims, filename):
         assert zim._get_entry_by_id(index).get_item()._index >= 0
 
 
+@pytest.mark.parametrize(*parametrize_for(["filename", "entry_count"]))
+def test_reader_iterators(all_zims, filename, entry_count):
+    zim = Archive(all_zims / filename)
+
+    by_path = list(zim.iter_by_path())
+    assert len(by_path) == entry_count
+    assert [entry._index for entry in by_path] == list(range(entry_count))
+    paths = {entry.path for entry in by_path}
+
+    efficient = list(zim.iter_efficient(chunk_size=7))
+    assert len(efficient) == entry_count
+    assert {entry.path for entry in efficient} == paths
+
+    assert {entry.path for entry in zim.iter_by_title()} <= paths
+
+    iterator = zim.iter_by_path(chunk_size=10)
+    chunks = []
+    chunk = iterator.next_chunk()
+    while chunk:
+        assert 0 < len(chunk) <= 10
+        chunks.append(chunk)
+        chunk = iterator.next_chunk()
+    assert [entry.path for chunk in chunks for entry in chunk] == [
+        entry.path for entry in by_path
+    ]
+    with pytest.raises(StopIteration):
+        next(iterator)
+
+
 def test_archive_equality(all_zims):
     class Different:
         def __init__(self, filename):
@@ -492,3 +973,359 @@ def test_archive_equality(all_zims):
     assert zim != Different(fpath1)
     assert zim == Sub(fpath1)
     assert zim != Sub2(fpath1)
+
+    # hashable, by content identity
+    assert hash(zim) == hash(Archive(fpath1)) == hash(Sub(fpath1))
+    assert len({zim, Archive(fpath1), Archive(fpath2)}) == 2
+    assert {zim: 1}[Archive(fpath1, shared=False)] == 1
+
+    # a copy has the same UUID but is another file
+    copy = pathlib.Path(fpath1).with_name("zimfile-copy.zim")
+    copy.write_bytes(pathlib.Path(fpath1).read_bytes())
+    try:
+        assert Archive(copy).uuid == zim.uuid
+        assert Archive(copy) != zim
+    finally:
+        copy.unlink()
+
+
+@pytest.mark.parametrize(*parametrize_for(["filename", "zim_uuid"]))
+def test_reader_uuid(all_zims, filename, zim_uuid):
+    zim = Archive(all_zims / filename)
+    assert isinstance(zim.uuid_bytes, bytes)
+    assert len(zim.uuid_bytes) == 16
+    assert zim.uuid.bytes == zim.uuid_bytes
+    # cached
+    assert zim.uuid is zim.uuid
+    assert zim.uuid_bytes is zim.uuid_bytes
+    if zim_uuid:
+        assert zim.uuid_bytes.hex() == zim_uuid
+
+
+@pytest.mark.parametrize("shared, prefault", [(True, False), (False, True)])
+def test_archive_shared(tmpdir, shared, prefault):
+    fpath = pathlib.Path(tmpdir / "shared.zim")
+
+    def create(content):
+        with libzim.writer.Creator(fpath) as c:
+            c.add_item(libzim.writer.StaticItem("home", "", "text/plain", content))
+
+    create("first")
+    first = Archive(fpath, shared=shared, prefault=prefault)
+    second = Archive(str(fpath), shared=shared, prefault=prefault)
+    assert first == second
+    assert second.filename == fpath
+
+    # closing one does not affect the other
+    del first
+    gc.collect()
+    assert bytes(second.get_entry_by_path("home").get_item().content) == b"first"
+
+    # a replaced file is not served from the previously opened one
+    time.sleep(0.01)
+    fpath.unlink()
+    create("second content")
+    third = Archive(fpath, shared=shared, prefault=prefault)
+    assert bytes(third.get_entry_by_path("home").get_item().content) == (
+        b"second content"
+    )
+    assert bytes(second.get_entry_by_path("home").get_item().content) == b"first"
+
+
+def test_archive_shared_threads(all_zims):
+    archives = []
+
+    def opener():
+        archives.append(Archive(all_zims / "example.zim", shared=True))
+
+    threads = [threading.Thread(target=opener) for _ in range(0, 8)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert len({archive.uuid for archive in archives}) == 1
+    assert all(archive.entry_count == archives[0].entry_count for archive in archives)
+
+
+def test_archive_cache_config(all_zims, monkeypatch):
+    fpath = all_zims / "example.zim"
+    zim = Archive(fpath, cluster_cache_size=64, dirent_cache_size=4096)
+    assert zim.cache_sizes == {"cluster": 64, "dirent": 4096}
+    assert zim._get_entry_by_id(0).get_item().size is not None
+
+    # tiny caches work as well
+    zim = Archive(fpath, shared=False, cluster_cache_size=1, dirent_cache_size=1)
+    for entry in itertools.islice(zim.iter_by_path(), 50):
+        assert entry.get_item().content is not None
+    assert zim.cache_sizes["cluster"] == 1
+
+    # defaults, from environment
+    monkeypatch.setenv("ZIM_CLUSTERCACHE", "32")
+    monkeypatch.delenv("ZIM_DIRENTCACHE", raising=False)
+    zim = Archive(fpath)
+    assert zim.cache_sizes["cluster"] == 32
+    assert zim.cache_sizes["dirent"] == 512
+
+    with pytest.raises(ValueError):
+        Archive(fpath, cluster_cache_size=-1)
+
+
+def test_reader_async(all_zims):
+    zim = Archive(all_zims / "example.zim")
+    paths = [zim._get_entry_by_id(index).path for index in range(0, 20)]
+
+    async def read_all():
+        entries = await asyncio.gather(*[zim.aget_entry_by_path(p) for p in paths])
+        items = await asyncio.gather(*[zim.aget_item(p) for p in paths])
+        return entries, items
+
+    entries, items = asyncio.run(read_all())
+    for path, entry, item in zip(paths, entries, items):
+        assert entry.path == path
+        expected = zim.get_entry_by_path(path).get_item()
+        assert item.path == expected.path
+        assert bytes(item.content) == bytes(expected.content)
+
+    async def missing():
+        with pytest.raises(KeyError):
+            await zim.aget_item("missing")
+        with pytest.raises(KeyError):
+            await zim.aget_entry_by_path("missing")
+        # cancelled tasks are ignored
+        zim.aget_item(paths[0]).cancel()
+        assert (await zim.aget_entry_by_path(paths[0])).path == paths[0]
+
+    asyncio.run(missing())
+
+    # closed loops are released, even with futures still pending
+    async def pending():
+        return zim.aget_item(paths[0])
+
+    loop = asyncio.new_event_loop()
+    loop_ref = weakref.ref(loop)
+    future = loop.run_until_complete(pending())
+    loop.close()
+    del future, loop
+    asyncio.run(read_all())
+    gc.collect()
+    assert loop_ref() is None
+
+    # requires a running loop
+    with pytest.raises(RuntimeError):
+        zim.aget_item(paths[0])
+
+
+@pytest.mark.parametrize("compression", ["none", "zstd"])
+def test_reader_stats(tmpdir, compression):
+    fpath = pathlib.Path(tmpdir / f"{compression}.zim")
+    content = b"<html><body>" + b"counted " * 1000 + b"</body></html>"
+    with libzim.writer.Creator(fpath).config_compression(compression) as c:
+        c.add_item(libzim.writer.StaticItem("home", "Home", "text/html", content))
+
+    zim = Archive(fpath)
+    assert zim.stats is None
+    bytes(zim.get_entry_by_path("home").get_item().content)
+
+    traced = []
+    stats = zim.enable_stats(ReaderStats(trace=lambda *args: traced.append(args)))
+    assert zim.enable_stats() is stats is zim.stats
+    assert zim.has_entry_by_path("home")
+    item = zim.get_entry_by_path("home").get_item()
+    with pytest.raises(KeyError):
+        zim.get_entry_by_path("missing")
+    zim.get_entry_by_title("Home")
+    assert bytes(item.content) == content
+    assert bytes(item.read(0, 12)) == content[:12]
+
+    assert stats.lookups_by_path == 3
+    assert stats.lookups_by_title == 1
+    assert stats.blob_bytes == len(content) + 12
+    if compression == "none":
+        assert stats.cluster_decompressions == 0
+    else:
+        assert stats.cluster_decompressions == 2
+        assert stats.bytes_decompressed == len(content) + 12
+    assert [event[:2] for event in traced] == [
+        ("get_entry_by_path", "home"),
+        ("get_entry_by_path", "missing"),
+        ("content", "home"),
+        ("content", "home"),
+    ]
+    assert all(event[2] >= 0 for event in traced)
+
+    data = stats.as_dict()
+    assert data["get_entry_by_path_latency"]["count"] == 2
+    assert data["content_latency"]["count"] == 2
+    assert data["content_latency"]["buckets"][-1] == (float("inf"), 2)
+
+    text = stats.to_prometheus(labels={"zim": "test"})
+    assert 'libzim_reader_lookups_by_path_total{zim="test"} 3\n' in text
+    assert "# TYPE libzim_reader_content_latency_seconds histogram\n" in text
+    bucket = "libzim_reader_content_latency_seconds_bucket"
+    assert f'{bucket}{{zim="test",le="+Inf"}} 2\n' in text
+    assert 'libzim_reader_get_entry_by_path_latency_seconds_count{zim="test"} 2' in text
+
+    stats.reset()
+    assert stats.lookups_by_path == 0
+    assert stats.as_dict()["content_latency"]["count"] == 0
+
+    # aggregated over archives, and no more counted once disabled
+    other = Archive(fpath)
+    assert other.enable_stats(stats) is stats
+    other.get_entry_by_path("home")
+    zim.disable_stats()
+    zim.get_entry_by_path("home")
+    assert zim.stats is None
+    assert stats.lookups_by_path == 1
+
+
+def test_reader_cached_attributes(tmpdir):
+    fpath = pathlib.Path(tmpdir / "mimetypes.zim")
+    with libzim.writer.Creator(fpath) as c:
+        c.add_item(libzim.writer.StaticItem("page", "Page", "text/html", "<p>a</p>"))
+        c.add_item(libzim.writer.StaticItem("image", "", "image/png", b"\x89PNG"))
+        c.add_item(libzim.writer.StaticItem("other", "", "text/html", "<p>b</p>"))
+        c.add_redirection("redirect", "Redirect", "page")
+
+    zim = Archive(fpath)
+    assert {"text/html", "image/png"} <= set(zim.mimetypes)
+
+    entry = zim.get_entry_by_path("page")
+    assert entry.path == "page"
+    assert entry.path is entry.path
+    assert entry.title is entry.title
+    item = entry.get_item()
+    assert entry.get_item() is item
+    assert item.mimetype is item.mimetype
+    assert item.path is item.path
+    assert item.title == "Page"
+
+    indexes = {}
+    for path in ("page", "image", "other"):
+        item = zim.get_entry_by_path(path).get_item()
+        assert zim.mimetypes[item.mimetype_index] == item.mimetype
+        indexes[path] = item.mimetype_index
+    assert indexes["page"] == indexes["other"] != indexes["image"]
+
+    redirect = zim.get_entry_by_path("redirect")
+    assert redirect.get_item().path == "page"
+    assert redirect.get_item().mimetype_index == indexes["page"]
+
+
+@pytest.mark.parametrize("compression", ["none", "zstd"])
+def test_reader_item_open(tmpdir, compression):
+    fpath = pathlib.Path(tmpdir / f"{compression}.zim")
+    content = bytes(range(256)) * 12289  # ~3MiB, not a multiple of chunks
+    with libzim.writer.Creator(fpath).config_compression(compression) as c:
+        c.add_item(libzim.writer.StaticItem("data", "", "application/data", content))
+    item = Archive(fpath).get_entry_by_path("data").get_item()
+
+    with item.open() as reader:
+        assert isinstance(reader, io.RawIOBase)
+        assert reader.readable() and reader.seekable() and not reader.writable()
+        assert reader.item is item
+        out = io.BytesIO()
+        shutil.copyfileobj(reader, out, 65536)
+        assert out.getvalue() == content
+        assert reader.tell() == len(content)
+        assert reader.read(10) == b""
+
+        assert reader.seek(-10, io.SEEK_END) == len(content) - 10
+        assert reader.read() == content[-10:]
+        reader.seek(1000)
+        buffer = bytearray(100)
+        assert reader.readinto(buffer) == 100
+        assert buffer == content[1000:1100]
+        assert reader.seek(5, io.SEEK_CUR) == 1105
+        assert reader.read(5) == content[1105:1110]
+        with pytest.raises(ValueError):
+            reader.seek(-1)
+        with pytest.raises((BufferError, TypeError)):
+            reader.readinto(b"read-only")
+
+        reader.seek(0)
+        digest = hashlib.sha1()
+        for chunk in iter(lambda: reader.read(1 << 20), b""):
+            digest.update(chunk)
+        assert digest.digest() == hashlib.sha1(content).digest()
+
+        reader.seek(0)
+        buffered = io.BufferedReader(reader)
+        assert buffered.read(3) == content[:3]
+
+    assert reader.closed
+    with pytest.raises(ValueError):
+        reader.read(1)
+
+
+@pytest.mark.parametrize("compression", ["none", "zstd"])
+def test_reader_prefetch(tmpdir, compression):
+    fpath = pathlib.Path(tmpdir / f"{compression}.zim")
+    with libzim.writer.Creator(fpath).config_compression(compression) as c:
+        for index in range(0, 10):
+            c.add_item(
+                libzim.writer.StaticItem(
+                    f"res{index}", "", "text/css", f"body {{ margin: {index}px }}"
+                )
+            )
+        c.add_redirection("alias", "", "res0")
+
+    zim = Archive(fpath)
+    paths = [f"res{index}" for index in range(0, 10)] + ["alias", "missing"]
+    assert zim.prefetch(paths) == len(paths)
+    assert zim.prefetch(iter(paths[:2]), advise=False) == 2
+    assert zim.prefetch([]) == 0
+    # prefetching is transparent to reads, even while still running
+    for index in range(0, 10):
+        content = bytes(zim.get_entry_by_path(f"res{index}").get_item().content)
+        assert content == f"body {{ margin: {index}px }}".encode()
+
+    # archive can be released while its entries are being prefetched
+    zim.prefetch(paths)
+    del zim
+
+
+def test_reader_read_headers(all_zims, indexed_zim, tmpdir):
+    not_zim = pathlib.Path(tmpdir / "not-zim.zim")
+    not_zim.write_text("text file")
+    filenames = [all_zims / name for name in sorted(ZIMS_DATA)] + [indexed_zim]
+
+    headers = read_headers(filenames + [not_zim, tmpdir / "missing.zim"])
+    assert len(headers) == len(filenames) + 2
+    for filename, header in zip(filenames, headers):
+        assert isinstance(header, ArchiveHeader)
+        assert header.error is None
+        assert header.filename == filename
+        zim = Archive(filename)
+        assert header.uuid == zim.uuid
+        # all dirents, including metadata and indexes
+        assert header.entry_count >= zim.entry_count
+        assert header.filesize == zim.filesize
+        assert header.has_main_entry == zim.has_main_entry
+        assert header.has_checksum == zim.has_checksum
+        assert header.has_fulltext_index == zim.has_fulltext_index
+        assert sorted(header.metadata_keys) == sorted(zim.metadata_keys)
+        assert header.metadata == {}
+    assert headers[-1].error and headers[-2].error
+    assert headers[-1].uuid is None
+
+    header = read_header(all_zims / "example.zim", metadata=["Name", "missing"])
+    name = Archive(all_zims / "example.zim").get_metadata("Name")
+    assert header.metadata == {"Name": name}
+
+    # metadata in uncompressed clusters are read without libzim, others with it
+    for compression in ("none", "zstd"):
+        fpath = pathlib.Path(tmpdir / f"metadata-{compression}.zim")
+        with libzim.writer.Creator(fpath).config_compression(
+            libzim.writer.Compression[compression]
+        ) as c:
+            c.add_metadata("Title", b"A title")
+            c.add_metadata("Description", b"x" * 200)
+        header = read_header(fpath, metadata=["Title", "Description", "missing"])
+        assert header.metadata == {"Title": b"A title", "Description": b"x" * 200}
+
+    with pytest.raises(RuntimeError):
+        read_header(not_zim)
+    with pytest.raises(ValueError):
+        read_headers(filenames, threads=-1)
+    assert read_headers([]) == []